@@ -3,6 +3,7 @@
 #include "acceptor.hpp"
 #include "proxy.hpp"
 #include "stats.hpp"
+#include "globals.hpp"
 #include "utils/logging.hpp"
 #include "except/exceptions.hpp"
 #include "syscalls/fctl.h"
@@ -23,6 +24,7 @@ void Acceptor::turn_on_accepting()
 {
     if (!this->_accepting) {
         this->_accepting = true;
+        cerb_global::thread_stats.set(STAT_ACCEPTING, 1);
         this->_proxy->poll_add_ro(this);
         LOG(INFO) << "Start accepting - " << this->str();
     }
@@ -42,6 +44,7 @@ void Acceptor::on_events(int)
             LOG(WARNING) << "Too many open files. Stop accepting from " << this->str();
             LOG(WARNING) << stats_all();
             this->_accepting = false;
+            cerb_global::thread_stats.set(STAT_ACCEPTING, 0);
             return this->_proxy->poll_del(this);
         }
         if (errno != EAGAIN && errno != ECONNABORTED
@@ -0,0 +1,116 @@
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <cppformat/format.h>
+
+#include "admin.hpp"
+#include "stats.hpp"
+#include "except/exceptions.hpp"
+#include "utils/logging.hpp"
+#include "syscalls/cio.h"
+#include "syscalls/fctl.h"
+
+using namespace cerb;
+
+static msize_t const MAX_REQUEST_SIZE = 8192;
+static int const IO_TIMEOUT_SEC = 2;
+
+static std::string http_response(std::string const& status,
+                                 std::string const& content_type,
+                                 std::string const& body)
+{
+    return fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n"
+                       "Connection: close\r\n\r\n{}",
+                       status, content_type, body.size(), body);
+}
+
+static std::string admin_http_response(std::string const& request)
+{
+    std::string::size_type line_end = request.find("\r\n");
+    std::vector<std::string> request_line(util::split_str(
+        request.substr(0, line_end), " ", true));
+    if (request_line.size() != 3) {
+        return ::http_response("400 Bad Request", "text/plain", "Bad request\n");
+    }
+    if (request_line[0] != "GET") {
+        return ::http_response("405 Method Not Allowed", "text/plain",
+                               "Method not allowed\n");
+    }
+    std::string path(request_line[1].substr(0, request_line[1].find('?')));
+    if (path != "/metrics") {
+        return ::http_response("404 Not Found", "text/plain", "Not found\n");
+    }
+    return ::http_response(
+        "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8",
+        stats_openmetrics());
+}
+
+static void set_timeout(int fd)
+{
+    struct timeval tv;
+    tv.tv_sec = IO_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+}
+
+AdminListener::AdminListener(int port)
+    : _listen(fctl::new_stream_socket())
+    , _thread(nullptr)
+{
+    fctl::bind_to(this->_listen.fd, port);
+    LOG(INFO) << "Admin listener bound to port " << port;
+}
+
+void AdminListener::_serve(int fd)
+{
+    FDWrapper conn(fd);
+    ::set_timeout(fd);
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        if (request.size() > MAX_REQUEST_SIZE) {
+            LOG(DEBUG) << "Admin request too large on fd " << fd;
+            return;
+        }
+        ssize_t n = cio::read(fd, buf, sizeof buf);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, n);
+    }
+    std::string rsp(::admin_http_response(request));
+    char const* p = rsp.data();
+    msize_t left = rsp.size();
+    while (left != 0) {
+        ssize_t n = cio::write(fd, p, left);
+        if (n <= 0) {
+            return;
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+void AdminListener::run()
+{
+    this->_thread.reset(new std::thread(
+        [this]()
+        {
+            while (true) {
+                int cfd = cio::accept(this->_listen.fd);
+                if (cfd < 0) {
+                    if (errno != EINTR && errno != ECONNABORTED) {
+                        LOG(ERROR) << "Admin accept: " << strerror(errno);
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    }
+                    continue;
+                }
+                try {
+                    this->_serve(cfd);
+                } catch (std::runtime_error& e) {
+                    LOG(ERROR) << "Admin request failed: " << e.what();
+                }
+            }
+        }));
+    this->_thread->detach();
+}
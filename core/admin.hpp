@@ -0,0 +1,30 @@
+#ifndef __CERBERUS_ADMIN_HPP__
+#define __CERBERUS_ADMIN_HPP__
+
+#include <string>
+#include <thread>
+
+#include "fdutil.hpp"
+#include "utils/pointer.h"
+
+namespace cerb {
+
+    /*
+     * Minimal HTTP listener serving metrics in OpenMetrics format on its own
+     * thread with blocking IO, so scraping never runs on the proxy threads.
+     */
+    class AdminListener {
+        FDWrapper _listen;
+        util::sptr<std::thread> _thread;
+
+        void _serve(int fd);
+    public:
+        explicit AdminListener(int port);
+        AdminListener(AdminListener const&) = delete;
+
+        void run();
+    };
+
+}
+
+#endif /* __CERBERUS_ADMIN_HPP__ */
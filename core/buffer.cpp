@@ -2,6 +2,7 @@
 #include <algorithm>
 
 #include "buffer.hpp"
+#include "globals.hpp"
 #include "except/exceptions.hpp"
 #include "utils/logging.hpp"
 
@@ -28,6 +29,7 @@ static void flush_mem(int fd, byte const* mem, msize_t sz)
     msize_t n = 0;
     while (n < sz) {
         ssize_t nwrite = cio::write(fd, mem + n, sz - n);
+        cerb_global::thread_stats.io_call(STAT_WRITE_CALLS, STAT_WRITE_BYTES, nwrite);
         if (nwrite == -1) {
             on_error("buffer write");
             continue;
@@ -41,14 +43,19 @@ void cerb::flush_string(int fd, std::string const& s)
     ::flush_mem(fd, reinterpret_cast<byte const*>(s.data()), s.size());
 }
 
-int Buffer::read(int fd)
+int Buffer::read(int fd, msize_t limit)
 {
     byte local[BUFFER_SIZE];
-    int n = 0, nread;
-    while ((nread = cio::read(fd, local, BUFFER_SIZE)) > 0) {
+    int n = 0, nread = 0;
+    while (msize_t(n) < limit && (nread = cio::read(fd, local, BUFFER_SIZE)) > 0) {
+        cerb_global::thread_stats.io_call(STAT_READ_CALLS, STAT_READ_BYTES, nread);
         n += nread;
         this->_buffer.insert(this->_buffer.end(), local, local + nread);
     }
+    if (nread > 0) {
+        return n;
+    }
+    cerb_global::thread_stats.io_call(STAT_READ_CALLS, STAT_READ_BYTES, nread);
     if (nread == -1) {
         on_error("buffer read");
     }
@@ -101,6 +108,7 @@ static int write_single(int fd, byte const* buf, int buf_len, int* offset)
 {
     while (*offset < buf_len) {
         ssize_t nwritten = cio::write(fd, buf + *offset, buf_len - *offset);
+        cerb_global::thread_stats.io_call(STAT_WRITE_CALLS, STAT_WRITE_BYTES, nwritten);
         if (nwritten == -1) {
             on_error("buffer write");
             return 0;
@@ -111,6 +119,13 @@ static int write_single(int fd, byte const* buf, int buf_len, int* offset)
     return 1;
 }
 
+static ssize_t count_writev(int fd, cio::iovec const* iov, int iovcnt)
+{
+    ssize_t n = cio::writev(fd, iov, iovcnt);
+    cerb_global::thread_stats.io_call(STAT_WRITEV_CALLS, STAT_WRITEV_BYTES, n);
+    return n;
+}
+
 static int write_vec(int fd, int iovcnt, cio::iovec* iov, ssize_t total, int* first_offset)
 {
     if (1 == iovcnt) {
@@ -123,7 +138,7 @@ static int write_vec(int fd, int iovcnt, cio::iovec* iov, ssize_t total, int* fi
     iov->iov_len -= *first_offset;
     int written_iov = 0;
     ssize_t nwritten;
-    while (total != (nwritten = cio::writev(fd, iov + written_iov, iovcnt - written_iov))) {
+    while (total != (nwritten = ::count_writev(fd, iov + written_iov, iovcnt - written_iov))) {
         if (nwritten == 0) {
             return written_iov;
         }
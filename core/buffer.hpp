@@ -94,7 +94,13 @@ namespace cerb {
             return this->_buffer.data();
         }
 
-        int read(int fd);
+        void resize(size_type n)
+        {
+            _buffer.resize(n);
+        }
+
+        /* reads until EAGAIN, or stops once at least limit bytes are read */
+        int read(int fd, msize_t limit=msize_t(-1));
         int write(int fd) const;
         void truncate_from_begin(iterator i);
         void buffer_ready(std::vector<cio::iovec>& iov);
@@ -128,6 +134,21 @@ namespace cerb {
             return this->_buf_arr.empty();
         }
 
+        msize_t buffers_count() const
+        {
+            return this->_buf_arr.size();
+        }
+
+        /* bytes not yet written */
+        msize_t size() const
+        {
+            msize_t s = 0;
+            for (auto const& b: this->_buf_arr) {
+                s += b->size();
+            }
+            return s - (this->_buf_arr.empty() ? 0 : this->_1st_buf_offset);
+        }
+
         bool writev(int fd);
     };
 
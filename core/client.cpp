@@ -1,11 +1,16 @@
+#include <sys/timerfd.h>
 #include <algorithm>
 #include <cppformat/format.h>
 
 #include "client.hpp"
 #include "proxy.hpp"
 #include "server.hpp"
+#include "stats.hpp"
+#include "globals.hpp"
+#include "probes.hpp"
 #include "except/exceptions.hpp"
 #include "utils/logging.hpp"
+#include "syscalls/cio.h"
 #include "syscalls/poll.h"
 
 using namespace cerb;
@@ -13,29 +18,144 @@ using namespace cerb;
 static msize_t const MAX_PIPE = 64;
 static msize_t const MAX_RESPONSES = 256;
 
+namespace {
+
+    /* clients of the thread in the middle of streamed requests */
+    thread_local std::set<Client*> streaming_clients;
+
+    /*
+     * A periodic timer checking clients that stream requests, armed while
+     * there is any, so a client that stalls in the middle of a request
+     * does not hold back commands of others to the node for ever
+     */
+    class RequestStallChecker
+        : public ProxyConnection
+    {
+        Proxy* const _proxy;
+        bool _armed;
+
+        void _set_timer(int64_t ns)
+        {
+            struct itimerspec spec;
+            spec.it_interval.tv_sec = ns / 1000000000;
+            spec.it_interval.tv_nsec = ns % 1000000000;
+            spec.it_value = spec.it_interval;
+            if (::timerfd_settime(this->fd, 0, &spec, nullptr) == -1) {
+                throw SystemError("timerfd_settime", errno);
+            }
+        }
+    public:
+        explicit RequestStallChecker(Proxy* p)
+            : ProxyConnection(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+            , _proxy(p)
+            , _armed(false)
+        {
+            if (this->fd == -1) {
+                throw SystemError("timerfd_create", errno);
+            }
+            p->poll_add_ro(this);
+        }
+
+        void arm()
+        {
+            if (this->_armed) {
+                return;
+            }
+            /* a stall is found within 1.5 times the timeout */
+            this->_set_timer(std::max(int64_t(1000000), int64_t(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(cerb_global::request_stream_timeout).count() / 2)));
+            this->_armed = true;
+        }
+
+        void on_events(int)
+        {
+            uint64_t expirations;
+            cio::read(this->fd, &expirations, sizeof expirations);
+            Time now(Clock::now());
+            std::vector<Client*> clients(::streaming_clients.begin(),
+                                         ::streaming_clients.end());
+            for (Client* c: clients) {
+                c->check_request_stall(now);
+            }
+            if (::streaming_clients.empty()) {
+                this->_set_timer(0);
+                this->_armed = false;
+            }
+        }
+
+        void after_events(std::set<Connection*>&) {}
+
+        std::string str() const
+        {
+            return fmt::format("RequestStallChecker({}@{})", this->fd,
+                               static_cast<void const*>(this));
+        }
+    };
+
+    thread_local RequestStallChecker* stall_checker(nullptr);
+
+    void watch_request_stall(Client* c, Proxy* p)
+    {
+        ::streaming_clients.insert(c);
+        if (::stall_checker == nullptr) {
+            ::stall_checker = new RequestStallChecker(p);
+        }
+        ::stall_checker->arm();
+    }
+
+}
+
 Client::Client(int fd, Proxy* p)
     : ProxyConnection(fd)
     , _proxy(p)
     , _awaiting_count(0)
+    , _address(peer_address(fd))
+    , _info_slot(p->clients.add(this, fd, this->_address))
+    , _commands(0)
+    , _bytes_in(0)
+    , _bytes_out(0)
+    , _stream_source(nullptr)
+    , _request_streaming(false)
+    , _request_paused(false)
+    , _request_command(nullptr)
+    , _request_server(nullptr)
+    , transaction(nullptr)
+    , noreply(false)
 {
     p->poll_add_ro(this);
 }
 
 Client::~Client()
 {
+    ::streaming_clients.erase(this);
+    cerb_global::thread_stats.add(STAT_QUEUED_COMMANDS, -this->_awaiting_count);
+    this->_proxy->clients.remove(this->_info_slot);
     for (Server* svr: this->_peers) {
         svr->pop_client(this);
     }
     this->_proxy->pop_client(this);
 }
 
+void Client::close()
+{
+    if (!this->closed()) {
+        CERB_PROBE1(client__close, this->fd);
+    }
+    FDWrapper::close();
+}
+
+void Client::on_error()
+{
+    this->close();
+}
+
 void Client::on_events(int events)
 {
     if (poll::event_is_hup(events)) {
         return this->close();
     }
     try {
-        if (poll::event_is_read(events)) {
+        if (poll::event_is_read(events) && !this->_request_paused) {
             this->_read_request();
         }
         if (this->closed()) {
@@ -44,11 +164,13 @@ void Client::on_events(int events)
         if (poll::event_is_write(events)) {
             this->_write_response();
         }
-        if (this->_output_buffer_set.empty()) {
-            this->_proxy->set_conn_poll_ro(this);
-        } else {
+        if (!this->_output_buffer_set.empty()) {
             this->_proxy->set_conn_poll_rw(this);
+        } else if (!this->_request_paused) {
+            /* polling again would report the pending request before resumed */
+            this->_proxy->set_conn_poll_ro(this);
         }
+        this->_publish_info();
     } catch (BadRedisMessage& e) {
         LOG(DEBUG) << fmt::format("Receive bad message from {} because {}", this->str(), e.what());
         LOG(DEBUG) << "Dump buffer " << this->_buffer.to_string();
@@ -71,11 +193,42 @@ std::string Client::str() const
     return fmt::format("Client({}@{})", this->fd, static_cast<void const*>(this));
 }
 
+void Client::_publish_info()
+{
+    int64_t now = stat_ns(Clock::now().time_since_epoch());
+    this->_proxy->clients.update(
+        this->_info_slot,
+        [&](ClientInfo& info)
+        {
+            info.active_ns = now;
+            info.commands = this->_commands;
+            info.bytes_in = this->_bytes_in;
+            info.bytes_out = this->_bytes_out;
+            info.qbuf = this->_buffer.size();
+            info.obuf = this->_output_buffer_set.size();
+            info.pipeline = this->_parsed_groups.size() + this->_awaiting_groups.size()
+                          + this->_ready_groups.size();
+        });
+}
+
 void Client::_send_buffer_set()
 {
-    if (this->_output_buffer_set.writev(this->fd)) {
+    msize_t size = this->_output_buffer_set.size();
+    bool all_written = this->_output_buffer_set.writev(this->fd);
+    this->_bytes_out += size - this->_output_buffer_set.size();
+    if (this->_stream_source != nullptr &&
+        this->_output_buffer_set.size() < cerb_global::reply_stream_window)
+    {
+        this->_stream_source->resume_stream();
+        this->_stream_source = nullptr;
+    }
+    if (all_written) {
         for (auto const& g: this->_ready_groups) {
             g->collect_stats(this->_proxy);
+            if (g->trace.not_nul()) {
+                g->trace->stage(TRACE_CLIENT_WRITTEN);
+                this->_proxy->tracer.record(*g->trace);
+            }
         }
         this->_ready_groups.clear();
         if (this->_awaiting_groups.empty()) {
@@ -98,6 +251,7 @@ void Client::_push_awaitings_to_ready()
     }
     for (util::sptr<CommandGroup>& g: this->_awaiting_groups) {
         g->append_buffer_to(this->_output_buffer_set);
+        g->trace_stage(TRACE_CLIENT_QUEUED);
         this->_ready_groups.push_back(std::move(g));
     }
     this->_awaiting_groups.clear();
@@ -118,18 +272,130 @@ void Client::_write_response()
     this->_send_buffer_set();
 }
 
+/*
+ * With request-stream-window set, at most a window is read at first so
+ * that a large request could be streamed from its beginning, and so is
+ * each time while streaming, like Server::_recv_from
+ */
 void Client::_read_request()
 {
-    int n = this->_buffer.read(this->fd);
+    msize_t window = cerb_global::request_stream_window;
+    msize_t n = this->_buffer.read(this->fd, window == 0 ? msize_t(-1) : window);
+    this->_last_read = Clock::now();
+    this->_bytes_in += n;
     LOG(DEBUG) << "Read from " << this->str() << " current buffer size: "
                << this->_buffer.size() << " read returns " << n;
     if (n == 0) {
         return this->close();
     }
+    this->_on_received();
+    while (window != 0 && n >= window && !this->closed() && !this->_request_paused) {
+        n = this->_buffer.read(this->fd, this->_request_streaming ? window : msize_t(-1));
+        this->_bytes_in += n;
+        if (n == 0) {
+            return;
+        }
+        this->_on_received();
+    }
+}
+
+void Client::_on_received()
+{
+    if (this->_request_streaming && !this->_stream_request()) {
+        return;
+    }
     ::split_client_command(this->_buffer, util::mkref(*this));
     if (this->_awaiting_groups.empty()) {
         this->_process();
     }
+    if (this->_start_request_stream()) {
+        this->_stream_request();
+    }
+}
+
+/*
+ * The rest of the buffer is the beginning of a request; if it is already
+ * larger than the window, pass it on from now on, unless the client awaits
+ * or writes replies to former commands, or the request is not of a single
+ * key command, or the thread is overloaded.
+ */
+bool Client::_start_request_stream()
+{
+    if (cerb_global::request_stream_window == 0 ||
+        this->_buffer.size() < cerb_global::request_stream_window ||
+        this->_info_slot == ClientRegistry::NO_SLOT ||
+        this->transaction.not_nul() || this->bulk ||
+        !this->_parsed_groups.empty() || !this->_awaiting_groups.empty() ||
+        !this->_output_buffer_set.empty() || this->_proxy->shedder.overloaded())
+    {
+        return false;
+    }
+    util::sref<DataCommand> cmd(nullptr);
+    util::sptr<CommandGroup> g(stream_client_command(this->_buffer, util::mkref(*this), cmd));
+    if (g.nul()) {
+        return false;
+    }
+    Server* svr = this->_proxy->get_server_by_slot(cmd->key_slot());
+    if (svr == nullptr || !svr->request_stream_ready()) {
+        return false;
+    }
+    LOG(DEBUG) << "Stream request of " << this->str() << " to " << svr->str();
+    svr->start_request_stream(cmd);
+    this->push_command(std::move(g));
+    this->_process();
+    this->_request_streaming = true;
+    this->_request_command = cmd;
+    this->_request_server = svr;
+    this->_request_scanner = ReplyScanner();
+    this->_request_progress = Clock::now();
+    ::watch_request_stall(this, this->_proxy);
+    cerb_global::thread_stats.add(STAT_STREAMED_REQUESTS, 1);
+    return true;
+}
+
+/* returns whether the streamed request is complete */
+bool Client::_stream_request()
+{
+    msize_t n = this->_request_scanner.scan(this->_buffer.begin(), this->_buffer.end());
+    if (n != 0) {
+        Buffer chunk;
+        if (n == this->_buffer.size()) {
+            chunk.swap(this->_buffer);
+        } else {
+            chunk = Buffer(this->_buffer.begin(), this->_buffer.begin() + n);
+            this->_buffer.truncate_from_begin(this->_buffer.begin() + n);
+        }
+        cerb_global::thread_stats.add(STAT_STREAMED_REQUEST_BYTES, n);
+        this->_request_progress = Clock::now();
+        if (this->_request_command.not_nul()) {
+            this->_request_paused = !this->_request_server->stream_request(
+                std::move(chunk), this->_request_scanner.finished(), this);
+        }
+    }
+    if (!this->_request_scanner.finished()) {
+        return false;
+    }
+    this->_request_streaming = false;
+    this->_request_paused = false;
+    this->_request_command.reset();
+    this->_request_server = nullptr;
+    ::streaming_clients.erase(this);
+    return true;
+}
+
+void Client::resume_request()
+{
+    if (!this->_request_paused) {
+        return;
+    }
+    this->_request_paused = false;
+    this->_request_progress = Clock::now();
+    /* polling again reports the request left in the socket */
+    if (this->_output_buffer_set.empty()) {
+        this->_proxy->set_conn_poll_ro(this);
+    } else {
+        this->_proxy->set_conn_poll_rw(this);
+    }
 }
 
 void Client::reactivate(util::sref<Command> cmd)
@@ -144,10 +410,16 @@ void Client::reactivate(util::sref<Command> cmd)
 
 void Client::_process()
 {
+    for (auto const& g: this->_awaiting_groups) {
+        if (g->holds_pipeline()) {
+            return;
+        }
+    }
     msize_t pipe_groups = std::min(msize_t(this->_parsed_groups.size()), MAX_PIPE);
     LOG(DEBUG) << fmt::format("{} Process {} over {} commands", this->str(), pipe_groups, this->_parsed_groups.size());
-    for (msize_t i = 0; i < pipe_groups; ++i) {
-        auto& g = this->_parsed_groups[i];
+    msize_t i = 0;
+    while (i < pipe_groups) {
+        auto& g = this->_parsed_groups[i++];
         if (g->long_connection()) {
             this->_proxy->poll_del(this);
             g->deliver_client(this->_proxy);
@@ -157,15 +429,20 @@ void Client::_process()
 
         if (g->wait_remote()) {
             ++this->_awaiting_count;
+            cerb_global::thread_stats.add(STAT_QUEUED_COMMANDS, 1);
             g->select_remote(this->_proxy);
         }
+        bool hold = g->holds_pipeline();
         this->_awaiting_groups.push_back(std::move(g));
+        if (hold) {
+            break;
+        }
     }
-    if (pipe_groups == this->_parsed_groups.size()) {
+    if (i == this->_parsed_groups.size()) {
         this->_parsed_groups.clear();
     } else {
         this->_parsed_groups.erase(this->_parsed_groups.begin(),
-                                   this->_parsed_groups.begin() + pipe_groups);
+                                   this->_parsed_groups.begin() + i);
     }
 
     if (0 < this->_awaiting_count) {
@@ -181,15 +458,69 @@ void Client::_process()
 void Client::group_responsed()
 {
     --this->_awaiting_count;
+    cerb_global::thread_stats.add(STAT_QUEUED_COMMANDS, -1);
     this->_push_awaitings_to_ready();
 }
 
+bool Client::remote_pending() const
+{
+    return this->_awaiting_count != 0 || std::any_of(
+        this->_parsed_groups.begin(), this->_parsed_groups.end(),
+        [](util::sptr<CommandGroup> const& g)
+        {
+            return g->wait_remote();
+        });
+}
+
 void Client::add_peer(Server* svr)
 {
     this->_peers.insert(svr);
 }
 
+bool Client::stream_ready(util::sref<CommandGroup> g) const
+{
+    /* replies to former groups are in the output already */
+    return this->_info_slot != ClientRegistry::NO_SLOT && !this->_awaiting_groups.empty()
+        && g.is(*this->_awaiting_groups.front());
+}
+
+bool Client::stream_reply(Buffer chunk, Server* s)
+{
+    this->_output_buffer_set.append(std::make_shared<Buffer>(std::move(chunk)));
+    this->_proxy->set_conn_poll_rw(this);
+    if (this->_output_buffer_set.size() < cerb_global::reply_stream_window) {
+        return true;
+    }
+    this->_stream_source = s;
+    return false;
+}
+
+void Client::check_request_stall(Time now)
+{
+    if (this->_request_paused ||
+        now - this->_request_progress < cerb_global::request_stream_timeout)
+    {
+        return;
+    }
+    LOG(WARNING) << this->str() << " stalls in the middle of a streamed request, close it";
+    cerb_global::thread_stats.add(STAT_STREAMED_REQUEST_STALLS, 1);
+    this->abort();
+}
+
+void Client::abort()
+{
+    this->_proxy->clients.kill(this->_info_slot);
+    /* the next loop may not come soon if nothing else is polled */
+    this->_proxy->wakeup();
+    /* the rest of a streamed request is dropped, not taken as commands */
+    this->_request_command.reset();
+    this->_request_server = nullptr;
+    this->_request_paused = false;
+    ::streaming_clients.erase(this);
+}
+
 void Client::push_command(util::sptr<CommandGroup> g)
 {
+    ++this->_commands;
     this->_parsed_groups.push_back(std::move(g));
 }
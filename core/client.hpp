@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "command.hpp"
+#include "response.hpp"
 #include "connection.hpp"
 
 namespace cerb {
@@ -16,6 +17,7 @@ namespace cerb {
     {
         void _write_response();
         void _read_request();
+        void _on_received();
 
         Proxy* const _proxy;
         std::set<Server*> _peers;
@@ -23,22 +25,83 @@ namespace cerb {
         std::vector<util::sptr<CommandGroup>> _awaiting_groups;
         std::vector<util::sptr<CommandGroup>> _ready_groups;
         int _awaiting_count;
+        Time _last_read;
         Buffer _buffer;
         BufferSet _output_buffer_set;
+        std::string const _address;
+        msize_t const _info_slot;
+        uint64_t _commands;
+        uint64_t _bytes_in;
+        uint64_t _bytes_out;
+        /* a server not reading a streamed reply until the output is written */
+        Server* _stream_source;
+        /*
+         * A request at the head of the buffer passed on to a server as it
+         * arrives; the command is nul if the client is to be closed, and
+         * the rest of the request is dropped. Reading is paused while the
+         * server has more than request-stream-window of it to write.
+         */
+        bool _request_streaming;
+        bool _request_paused;
+        util::sref<DataCommand> _request_command;
+        Server* _request_server;
+        ReplyScanner _request_scanner;
+        /* when the streamed request last went on, unless reading is paused */
+        Time _request_progress;
 
+        bool _start_request_stream();
+        bool _stream_request();
         void _process();
+        void _publish_info();
         void _send_buffer_set();
         void _push_awaitings_to_ready();
     public:
+        /* not nul between MULTI and EXEC or DISCARD */
+        util::sptr<Transaction> transaction;
+        /* not nul between PROXY BULK and PROXY BULK END */
+        std::shared_ptr<BulkIngest> bulk;
+        /* after PROXY NOREPLY ON, writes are acknowledged before sent */
+        bool noreply;
+
         Client(int fd, Proxy* p);
         ~Client();
 
         void on_events(int events);
         void after_events(std::set<Connection*>&);
+        void on_error();
         std::string str() const;
+        /* fires client__close with the descriptor before closing it */
+        void close();
+
+        Time last_read() const
+        {
+            return this->_last_read;
+        }
+
+        Proxy* proxy() const
+        {
+            return this->_proxy;
+        }
+
+        std::string const& address() const
+        {
+            return this->_address;
+        }
 
         void group_responsed();
+        /* whether a parsed command is yet to be replied by nodes */
+        bool remote_pending() const;
         void add_peer(Server* svr);
+        /* whether the reply to g could be passed on as it arrives */
+        bool stream_ready(util::sref<CommandGroup> g) const;
+        /* returns false if the output is over the window, and s is resumed once written */
+        bool stream_reply(Buffer chunk, Server* s);
+        /* called by the server of a streamed request once it is written */
+        void resume_request();
+        /* closes the client if its streamed request stalls over the timeout */
+        void check_request_stall(Time now);
+        /* a streamed reply or request is cut off; the client is closed in the next loop */
+        void abort();
         void reactivate(util::sref<Command> cmd);
         void push_command(util::sptr<CommandGroup> g);
     };
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <functional>
+#include <cppformat/format.h>
+
+#include "client_registry.hpp"
+#include "proxy.hpp"
+#include "stats.hpp"
+#include "globals.hpp"
+#include "except/exceptions.hpp"
+#include "utils/string.h"
+
+using namespace cerb;
+
+static std::atomic<uint64_t> next_client_id(1);
+
+msize_t ClientRegistry::add(Client* c, int fd, std::string const& addr)
+{
+    msize_t i;
+    if (!this->_free.empty()) {
+        i = this->_free.back();
+        this->_free.pop_back();
+    } else {
+        i = this->_size.load(std::memory_order_relaxed);
+        if (i == CHUNK_SIZE * MAX_CHUNKS) {
+            return NO_SLOT;
+        }
+        if (i % CHUNK_SIZE == 0) {
+            Chunk* chunk = new Chunk;
+            for (Slot& s: chunk->slots) {
+                s.seq.store(0, std::memory_order_relaxed);
+                s.kill_id.store(0, std::memory_order_relaxed);
+                s.info.id = 0;
+            }
+            this->_chunks[i / CHUNK_SIZE].store(chunk, std::memory_order_release);
+        }
+        this->_size.store(i + 1, std::memory_order_release);
+    }
+    Slot& s = this->_slot(i);
+    s.client = c;
+    int64_t now = stat_ns(Clock::now().time_since_epoch());
+    _write(s, [&](ClientInfo& info)
+               {
+                   info.id = ::next_client_id.fetch_add(1, std::memory_order_relaxed);
+                   info.fd = fd;
+                   info.created_ns = now;
+                   info.active_ns = now;
+                   info.commands = 0;
+                   info.bytes_in = 0;
+                   info.bytes_out = 0;
+                   info.qbuf = 0;
+                   info.obuf = 0;
+                   info.pipeline = 0;
+                   msize_t len = std::min(addr.size(), msize_t(ClientInfo::ADDR_SIZE - 1));
+                   std::copy(addr.begin(), addr.begin() + len, info.addr);
+                   info.addr[len] = '\0';
+               });
+    return i;
+}
+
+void ClientRegistry::remove(msize_t i)
+{
+    if (i == NO_SLOT) {
+        return;
+    }
+    Slot& s = this->_slot(i);
+    _write(s, [](ClientInfo& info) { info.id = 0; });
+    s.client = nullptr;
+    this->_free.push_back(i);
+}
+
+bool ClientRegistry::request_kill(uint64_t id)
+{
+    msize_t size = this->_size.load(std::memory_order_acquire);
+    for (msize_t i = 0; i < size; ++i) {
+        Slot& s = this->_slot(i);
+        uint64_t seq = s.seq.load(std::memory_order_acquire);
+        uint64_t slot_id;
+        std::memcpy(&slot_id, &s.info.id, sizeof slot_id);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq % 2 == 1 || seq != s.seq.load(std::memory_order_relaxed) || slot_id != id) {
+            continue;
+        }
+        s.kill_id.store(id, std::memory_order_relaxed);
+        this->_kill_requested.store(true, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
+
+static std::string format_client(ClientInfo const& c, int thread, int64_t now)
+{
+    return fmt::format(
+        "id={} addr={} fd={} thread={} age={} idle={} qbuf={} obuf={} pipeline={}"
+        " cmds={} net-in={} net-out={}\n",
+        c.id, c.addr, c.fd, thread, (now - c.created_ns) / 1000000000,
+        (now - c.active_ns) / 1000000000, c.qbuf, c.obuf, c.pipeline,
+        c.commands, c.bytes_in, c.bytes_out);
+}
+
+std::string cerb::client_list()
+{
+    std::string list;
+    int64_t now = stat_ns(Clock::now().time_since_epoch());
+    int thread = 0;
+    for (auto const& t: cerb_global::all_threads) {
+        t.get_proxy()->clients.for_each(
+            [&](ClientInfo const& c)
+            {
+                list += ::format_client(c, thread, now);
+            });
+        ++thread;
+    }
+    return fmt::format("${}\r\n{}\r\n", list.size(), list);
+}
+
+static int kill_clients(std::function<bool(ClientInfo const&)> match)
+{
+    int killed = 0;
+    for (auto& t: cerb_global::all_threads) {
+        util::sref<Proxy> p = t.get_proxy();
+        std::vector<uint64_t> ids;
+        p->clients.for_each(
+            [&](ClientInfo const& c)
+            {
+                if (match(c)) {
+                    ids.push_back(c.id);
+                }
+            });
+        for (uint64_t id: ids) {
+            if (p->clients.request_kill(id)) {
+                ++killed;
+            }
+        }
+        if (!ids.empty()) {
+            p->wakeup();
+        }
+    }
+    return killed;
+}
+
+std::string cerb::client_kill(std::vector<std::string> const& args)
+{
+    if (args.size() == 1) {
+        std::string const& addr = args[0];
+        if (::kill_clients([&](ClientInfo const& c) { return addr == c.addr; }) == 0) {
+            return "-ERR No such client\r\n";
+        }
+        return "+OK\r\n";
+    }
+    if (args.size() != 2) {
+        return "-ERR syntax error\r\n";
+    }
+    std::string filter(args[0]);
+    std::transform(filter.begin(), filter.end(), filter.begin(), ::toupper);
+    if (filter == "ADDR") {
+        std::string const& addr = args[1];
+        return fmt::format(":{}\r\n", ::kill_clients(
+            [&](ClientInfo const& c) { return addr == c.addr; }));
+    }
+    if (filter == "ID") {
+        uint64_t id;
+        try {
+            id = util::atoi(args[1]);
+        } catch (BadRedisMessage&) {
+            return "-ERR client-id should be greater than 0\r\n";
+        }
+        return fmt::format(":{}\r\n", ::kill_clients(
+            [&](ClientInfo const& c) { return id == c.id; }));
+    }
+    return "-ERR syntax error\r\n";
+}
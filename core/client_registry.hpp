@@ -0,0 +1,171 @@
+#ifndef __CERBERUS_CLIENT_REGISTRY_HPP__
+#define __CERBERUS_CLIENT_REGISTRY_HPP__
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <type_traits>
+
+#include "common.hpp"
+
+namespace cerb {
+
+    class Client;
+
+    struct ClientInfo {
+        static int const ADDR_SIZE = 48;
+
+        /* 0 if the slot is free */
+        uint64_t id;
+        int fd;
+        int64_t created_ns;
+        int64_t active_ns;
+        uint64_t commands;
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        msize_t qbuf;
+        msize_t obuf;
+        msize_t pipeline;
+        char addr[ADDR_SIZE];
+    };
+
+    /*
+     * Information of the clients of one thread. Only the owner thread adds,
+     * updates or removes entries; each entry is guarded by a sequence lock so
+     * any thread could copy consistent entries without blocking the owner.
+     * Entries live in chunks that are never freed before the registry, so
+     * readers never touch released memory.
+     */
+    class ClientRegistry {
+        static msize_t const CHUNK_SIZE = 256;
+        static msize_t const MAX_CHUNKS = 4096;
+
+        struct Slot {
+            std::atomic<uint64_t> seq;
+            /* set by any thread to the id of the client to kill */
+            std::atomic<uint64_t> kill_id;
+            ClientInfo info;
+            Client* client;
+        };
+
+        struct Chunk {
+            Slot slots[CHUNK_SIZE];
+        };
+
+        static_assert(std::is_trivially_copyable<ClientInfo>::value,
+                      "ClientInfo shall be trivially copyable");
+
+        std::atomic<Chunk*> _chunks[MAX_CHUNKS];
+        std::atomic<msize_t> _size;
+        std::vector<msize_t> _free;
+        std::atomic<bool> _kill_requested;
+
+        Slot& _slot(msize_t i) const
+        {
+            return _chunks[i / CHUNK_SIZE].load(std::memory_order_acquire)
+                ->slots[i % CHUNK_SIZE];
+        }
+
+        template <typename F>
+        static void _write(Slot& s, F f)
+        {
+            uint64_t seq = s.seq.load(std::memory_order_relaxed);
+            s.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            f(s.info);
+            s.seq.store(seq + 2, std::memory_order_release);
+        }
+    public:
+        static msize_t const NO_SLOT = msize_t(-1);
+
+        ClientRegistry()
+            : _size(0)
+            , _kill_requested(false)
+        {
+            for (msize_t i = 0; i < MAX_CHUNKS; ++i) {
+                _chunks[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ClientRegistry(ClientRegistry const&) = delete;
+
+        ~ClientRegistry()
+        {
+            for (msize_t i = 0; i < MAX_CHUNKS; ++i) {
+                delete _chunks[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        /* owner thread only; returns NO_SLOT if the registry is full */
+        msize_t add(Client* c, int fd, std::string const& addr);
+        void remove(msize_t i);
+
+        /* owner thread only; f(ClientInfo&) updates the entry */
+        template <typename F>
+        void update(msize_t i, F f)
+        {
+            if (i != NO_SLOT) {
+                _write(this->_slot(i), f);
+            }
+        }
+
+        /* owner thread only; call f with each live client requested to kill */
+        template <typename F>
+        void take_kills(F f)
+        {
+            if (!this->_kill_requested.exchange(false, std::memory_order_acquire)) {
+                return;
+            }
+            msize_t size = this->_size.load(std::memory_order_relaxed);
+            for (msize_t i = 0; i < size; ++i) {
+                Slot& s = this->_slot(i);
+                uint64_t id = s.kill_id.exchange(0, std::memory_order_relaxed);
+                if (id != 0 && id == s.info.id) {
+                    f(s.client);
+                }
+            }
+        }
+
+        /* any thread; call f with a copy of each live client */
+        template <typename F>
+        void for_each(F f) const
+        {
+            msize_t size = this->_size.load(std::memory_order_acquire);
+            for (msize_t i = 0; i < size; ++i) {
+                Slot const& s = this->_slot(i);
+                uint64_t seq = s.seq.load(std::memory_order_acquire);
+                if (seq % 2 == 1) {
+                    continue;
+                }
+                ClientInfo copy;
+                std::memcpy(&copy, &s.info, sizeof(ClientInfo));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq != s.seq.load(std::memory_order_relaxed) || copy.id == 0) {
+                    continue;
+                }
+                f(copy);
+            }
+        }
+
+        /* any thread; returns whether a client of the id is found */
+        bool request_kill(uint64_t id);
+
+        /* owner thread only */
+        void kill(msize_t i)
+        {
+            if (i != NO_SLOT) {
+                Slot& s = this->_slot(i);
+                s.kill_id.store(s.info.id, std::memory_order_relaxed);
+                this->_kill_requested.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    /* replies of CLIENT LIST and CLIENT KILL over all threads */
+    std::string client_list();
+    std::string client_kill(std::vector<std::string> const& args);
+
+}
+
+#endif /* __CERBERUS_CLIENT_REGISTRY_HPP__ */
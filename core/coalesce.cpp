@@ -0,0 +1,461 @@
+#include <sys/timerfd.h>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <cppformat/format.h>
+
+#include "coalesce.hpp"
+#include "command.hpp"
+#include "client.hpp"
+#include "proxy.hpp"
+#include "server.hpp"
+#include "response.hpp"
+#include "message.hpp"
+#include "slot_calc.hpp"
+#include "globals.hpp"
+#include "except/exceptions.hpp"
+#include "utils/logging.hpp"
+#include "utils/string.h"
+#include "syscalls/cio.h"
+#include "syscalls/poll.h"
+#include "syscalls/fctl.h"
+
+using namespace cerb;
+
+namespace {
+
+    class CoalescedGroup;
+
+    struct Waiter {
+        /* nul if the client is closed */
+        util::sref<CoalescedGroup> group;
+        int64_t delta;
+    };
+
+    /* summed increments of one counter, with clients awaiting replies */
+    struct Counter {
+        bool hash;
+        std::string key;
+        std::string field;
+        slot key_slot;
+        int64_t sum;
+        std::vector<Waiter> waiters;
+    };
+
+    class CoalescedGroup
+        : public CommandGroup
+    {
+        bool const _deferred;
+        Buffer _reply;
+    public:
+        bool const hash;
+        std::string const key;
+        std::string const field;
+        int64_t const delta;
+
+        CoalescedGroup(util::sref<Client> c, bool h, std::string k, std::string f, int64_t d)
+            : CommandGroup(c)
+            , _deferred(!cerb_global::coalesce_ack)
+            , _reply(_deferred ? "" : "+OK\r\n")
+            , hash(h)
+            , key(std::move(k))
+            , field(std::move(f))
+            , delta(d)
+        {}
+
+        void respond(Buffer rsp)
+        {
+            this->_reply = std::move(rsp);
+            this->command_responsed();
+        }
+
+        bool wait_remote() const
+        {
+            return this->_deferred;
+        }
+
+        void select_remote(Proxy* proxy);
+
+        void append_buffer_to(BufferSet& b)
+        {
+            b.append(std::make_shared<Buffer>(std::move(this->_reply)));
+        }
+
+        int total_buffer_size() const
+        {
+            return this->_reply.size();
+        }
+
+        void command_responsed()
+        {
+            this->client->group_responsed();
+        }
+    };
+
+    void reply_all(Counter const& c, std::string const& rsp)
+    {
+        if (c.waiters.empty()) {
+            LOG(ERROR) << "Coalesced increment " << c.sum << " of " << c.key
+                       << " lost because " << rsp;
+        }
+        for (Waiter const& w: c.waiters) {
+            if (w.group.not_nul()) {
+                w.group->respond(Buffer(rsp));
+            }
+        }
+    }
+
+    /* each client gets the value as if increments are run one after another */
+    void reply_counter(Counter const& c, Buffer const& rsp)
+    {
+        std::string r(rsp.to_string());
+        if (r.size() < 4 || r[0] != ':') {
+            return ::reply_all(c, r);
+        }
+        int64_t value = std::strtoll(r.c_str() + 1, nullptr, 10);
+        for (auto i = c.waiters.rbegin(); i != c.waiters.rend(); ++i) {
+            if (i->group.not_nul()) {
+                i->group->respond(Buffer(fmt::format(":{}\r\n", value)));
+            }
+            value -= i->delta;
+        }
+    }
+
+    void requeue(Proxy* p, Counter c);
+
+    /* a connection to a node on which summed increments are sent */
+    class CoalesceServer
+        : public ProxyConnection
+    {
+        Proxy* const _proxy;
+        Buffer _buffer;
+        BufferSet _output_buffer_set;
+        std::deque<Counter> _flushed;
+
+        CoalesceServer(util::Address const& a, Proxy* p)
+            : ProxyConnection(fctl::new_stream_socket())
+            , _proxy(p)
+            , addr(a)
+        {
+            fctl::set_nonblocking(this->fd);
+            fctl::connect_fd(addr.host, addr.port, this->fd);
+            LOG(INFO) << "Open " << this->str();
+            p->poll_add_rw(this);
+        }
+
+        void _recv_from()
+        {
+            if (this->_buffer.read(this->fd) == 0) {
+                throw ConnectionHungUp();
+            }
+            for (util::sptr<Response> const& rsp: split_server_response(this->_buffer)) {
+                if (this->_flushed.empty()) {
+                    LOG(ERROR) << "Unexpected reply on " << this->str();
+                    return this->on_error();
+                }
+                Counter c(std::move(this->_flushed.front()));
+                this->_flushed.pop_front();
+                if (rsp->server_moved()) {
+                    this->_proxy->update_slot_map();
+                    ::requeue(this->_proxy, std::move(c));
+                } else {
+                    ::reply_counter(c, rsp->get_buffer());
+                }
+            }
+        }
+    public:
+        util::Address const addr;
+
+        static CoalesceServer* get_server(util::Address const& addr, Proxy* p);
+
+        void push_counter(Counter c)
+        {
+            std::vector<std::string> args({c.key});
+            if (c.hash) {
+                args.push_back(c.field);
+            }
+            args.push_back(util::str(c.sum));
+            this->_output_buffer_set.append(std::make_shared<Buffer>(Buffer(
+                msg::format_command(c.hash ? "HINCRBY" : "INCRBY", args))));
+            this->_flushed.push_back(std::move(c));
+            cerb_global::thread_stats.add(STAT_COALESCED_FLUSHES, 1);
+            this->_proxy->set_conn_poll_rw(this);
+        }
+
+        void pop_client(Client* cli)
+        {
+            for (Counter& c: this->_flushed) {
+                for (Waiter& w: c.waiters) {
+                    if (w.group.not_nul() && w.group->client.is(cli)) {
+                        w.group.reset();
+                    }
+                }
+            }
+        }
+
+        void on_events(int events)
+        {
+            if (this->closed()) {
+                return;
+            }
+            if (poll::event_is_hup(events)) {
+                return this->on_error();
+            }
+            if (poll::event_is_read(events)) {
+                try {
+                    this->_recv_from();
+                } catch (BadRedisMessage& e) {
+                    LOG(ERROR) << "Receive bad message from " << this->str()
+                               << " because: " << e.what();
+                    return this->on_error();
+                }
+                if (this->closed()) {
+                    return;
+                }
+            }
+            if (poll::event_is_write(events)) {
+                this->_output_buffer_set.writev(this->fd);
+            }
+            if (this->_output_buffer_set.empty()) {
+                this->_proxy->set_conn_poll_ro(this);
+            } else {
+                this->_proxy->set_conn_poll_rw(this);
+            }
+        }
+
+        void on_error()
+        {
+            if (this->closed()) {
+                return;
+            }
+            LOG(INFO) << "Close " << this->str();
+            this->close();
+            this->_output_buffer_set.clear();
+            for (Counter const& c: this->_flushed) {
+                ::reply_all(c, "-ERR connection to the node closed before the reply\r\n");
+            }
+            this->_flushed.clear();
+            this->_proxy->update_slot_map();
+        }
+
+        void after_events(std::set<Connection*>&);
+
+        std::string str() const
+        {
+            return fmt::format("CoalesceServer({}@{})[{}]", this->fd,
+                               static_cast<void const*>(this), this->addr.str());
+        }
+    };
+
+    thread_local std::map<util::Address, CoalesceServer*> servers_map;
+
+    CoalesceServer* CoalesceServer::get_server(util::Address const& addr, Proxy* p)
+    {
+        auto i = ::servers_map.find(addr);
+        if (i != ::servers_map.end() && !i->second->closed()) {
+            return i->second;
+        }
+        CoalesceServer* s;
+        try {
+            s = new CoalesceServer(addr, p);
+        } catch (IOErrorBase& e) {
+            LOG(ERROR) << "Fail to open coalescing server " << addr.str()
+                       << " because " << e.what();
+            return nullptr;
+        }
+        ::servers_map[addr] = s;
+        return s;
+    }
+
+    void CoalesceServer::after_events(std::set<Connection*>&)
+    {
+        if (this->closed()) {
+            auto i = ::servers_map.find(this->addr);
+            if (i != ::servers_map.end() && i->second == this) {
+                ::servers_map.erase(i);
+            }
+            delete this;
+        }
+    }
+
+    void flush_all(Proxy* p);
+
+    /* a one-shot timer armed when the first increment of a window is added */
+    class Flusher
+        : public ProxyConnection
+    {
+        Proxy* const _proxy;
+        bool _armed;
+    public:
+        explicit Flusher(Proxy* p)
+            : ProxyConnection(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+            , _proxy(p)
+            , _armed(false)
+        {
+            if (this->fd == -1) {
+                throw SystemError("timerfd_create", errno);
+            }
+            p->poll_add_ro(this);
+        }
+
+        void arm()
+        {
+            if (this->_armed) {
+                return;
+            }
+            int64_t ns = std::max(int64_t(1), int64_t(std::chrono::duration_cast<
+                std::chrono::nanoseconds>(cerb_global::coalesce_window).count()));
+            struct itimerspec spec;
+            spec.it_interval.tv_sec = 0;
+            spec.it_interval.tv_nsec = 0;
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = ns % 1000000000;
+            if (::timerfd_settime(this->fd, 0, &spec, nullptr) == -1) {
+                throw SystemError("timerfd_settime", errno);
+            }
+            this->_armed = true;
+        }
+
+        void on_events(int)
+        {
+            uint64_t expirations;
+            cio::read(this->fd, &expirations, sizeof expirations);
+            this->_armed = false;
+            ::flush_all(this->_proxy);
+        }
+
+        void after_events(std::set<Connection*>&) {}
+
+        std::string str() const
+        {
+            return fmt::format("CoalesceFlusher({}@{})", this->fd,
+                               static_cast<void const*>(this));
+        }
+    };
+
+    thread_local std::map<std::string, Counter> pending;
+    thread_local Flusher* flusher(nullptr);
+
+    void arm_flusher(Proxy* p)
+    {
+        if (::flusher == nullptr) {
+            ::flusher = new Flusher(p);
+        }
+        ::flusher->arm();
+    }
+
+    std::string counter_id(bool hash, std::string const& key, std::string const& field)
+    {
+        return fmt::format("{}{}:{}{}", hash ? 'h' : 's', key.size(), key, hash ? field : "");
+    }
+
+    bool add_overflows(int64_t a, int64_t b)
+    {
+        return (b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b);
+    }
+
+    void flush_counter(Proxy* p, Counter c)
+    {
+        Server* svr = p->get_server_by_slot(c.key_slot);
+        CoalesceServer* s = svr == nullptr ? nullptr : CoalesceServer::get_server(svr->addr, p);
+        if (s == nullptr) {
+            p->update_slot_map();
+            return ::reply_all(c, "-CLUSTERDOWN The cluster is down\r\n");
+        }
+        s->push_counter(std::move(c));
+    }
+
+    void flush_all(Proxy* p)
+    {
+        std::map<std::string, Counter> counters(std::move(::pending));
+        ::pending.clear();
+        for (auto& i: counters) {
+            ::flush_counter(p, std::move(i.second));
+        }
+    }
+
+    void add(Proxy* p, bool hash, std::string const& key, std::string const& field,
+             int64_t delta, util::sref<CoalescedGroup> g)
+    {
+        std::string id(::counter_id(hash, key, field));
+        auto i = ::pending.find(id);
+        if (i != ::pending.end() && ::add_overflows(i->second.sum, delta)) {
+            ::flush_counter(p, std::move(i->second));
+            ::pending.erase(i);
+            i = ::pending.end();
+        }
+        if (i == ::pending.end()) {
+            KeySlotCalc calc;
+            for (char b: key) {
+                calc.next_byte(b);
+            }
+            Counter c{hash, key, field, calc.get_slot(), 0, std::vector<Waiter>()};
+            i = ::pending.insert(std::make_pair(std::move(id), std::move(c))).first;
+        }
+        i->second.sum += delta;
+        if (g.not_nul()) {
+            i->second.waiters.push_back(Waiter{g, delta});
+        }
+        cerb_global::thread_stats.add(STAT_COALESCED_INCREMENTS, 1);
+        ::arm_flusher(p);
+    }
+
+    /* put a counter that is moved back, ahead of increments added since */
+    void requeue(Proxy* p, Counter c)
+    {
+        std::string id(::counter_id(c.hash, c.key, c.field));
+        auto i = ::pending.find(id);
+        if (i == ::pending.end()) {
+            ::pending.insert(std::make_pair(std::move(id), std::move(c)));
+        } else if (::add_overflows(i->second.sum, c.sum)) {
+            return ::flush_counter(p, std::move(c));
+        } else {
+            c.sum += i->second.sum;
+            c.waiters.insert(c.waiters.end(), i->second.waiters.begin(),
+                             i->second.waiters.end());
+            i->second = std::move(c);
+        }
+        ::arm_flusher(p);
+    }
+
+    void CoalescedGroup::select_remote(Proxy* proxy)
+    {
+        ::add(proxy, this->hash, this->key, this->field, this->delta, util::mkref(*this));
+    }
+
+}
+
+bool cerb::coalesce_key(std::string const& key)
+{
+    for (std::string const& prefix: cerb_global::coalesce_prefixes) {
+        if (key.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+util::sptr<CommandGroup> cerb::coalesce_increment(
+    util::sref<Client> c, bool hash, std::string key, std::string field, int64_t delta)
+{
+    util::sptr<CoalescedGroup> g(new CoalescedGroup(
+        c, hash, std::move(key), std::move(field), delta));
+    if (!g->wait_remote()) {
+        ::add(c->proxy(), hash, g->key, g->field, delta, util::sref<CoalescedGroup>(nullptr));
+    }
+    return std::move(g);
+}
+
+void cerb::coalesce_pop_client(Client* cli)
+{
+    for (auto& i: ::pending) {
+        for (Waiter& w: i.second.waiters) {
+            if (w.group.not_nul() && w.group->client.is(cli)) {
+                w.group.reset();
+            }
+        }
+    }
+    for (auto& i: ::servers_map) {
+        i.second->pop_client(cli);
+    }
+}
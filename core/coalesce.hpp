@@ -0,0 +1,29 @@
+#ifndef __CERBERUS_COALESCE_HPP__
+#define __CERBERUS_COALESCE_HPP__
+
+#include <string>
+
+#include "common.hpp"
+#include "utils/pointer.h"
+
+namespace cerb {
+
+    class Client;
+    class CommandGroup;
+
+    /*
+     * Increments of counters under the keys of coalesce-prefixes are summed
+     * per key (and field of a hash) in each thread and flushed as one
+     * INCRBY or HINCRBY after coalesce-window-ms, on a connection to each
+     * node apart from those of clients.
+     */
+    bool coalesce_key(std::string const& key);
+    /* field is ignored unless hash is set */
+    util::sptr<CommandGroup> coalesce_increment(
+        util::sref<Client> c, bool hash, std::string key, std::string field, int64_t delta);
+    /* increments of the client are still flushed, but nothing is replied */
+    void coalesce_pop_client(Client* c);
+
+}
+
+#endif /* __CERBERUS_COALESCE_HPP__ */
@@ -1,4 +1,12 @@
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <cppformat/format.h>
 
 #include "message.hpp"
@@ -6,9 +14,18 @@
 #include "proxy.hpp"
 #include "client.hpp"
 #include "server.hpp"
+#include "response.hpp"
 #include "subscription.hpp"
 #include "stats.hpp"
 #include "slot_calc.hpp"
+#include "slowlog.hpp"
+#include "slot_stats.hpp"
+#include "client_registry.hpp"
+#include "monitor.hpp"
+#include "script_cache.hpp"
+#include "coalesce.hpp"
+#include "compression.hpp"
+#include "probes.hpp"
 #include "globals.hpp"
 #include "except/exceptions.hpp"
 #include "utils/logging.hpp"
@@ -21,6 +38,8 @@ namespace {
 
     std::string const RSP_OK_STR("+OK\r\n");
     std::shared_ptr<Buffer> const RSP_OK(new Buffer(RSP_OK_STR));
+    std::string const MULTI_CMD(msg::format_command("MULTI", std::vector<std::string>()));
+    std::string const EXEC_CMD(msg::format_command("EXEC", std::vector<std::string>()));
 
     Server* select_server_for(Proxy* proxy, DataCommand* cmd, slot key_slot)
     {
@@ -34,24 +53,97 @@ namespace {
         return svr;
     }
 
+    bool is_error_reply(Buffer& rsp)
+    {
+        return rsp.size() != 0 && *rsp.begin() == '-';
+    }
+
+    /* split an array reply into the count of elements and where they begin */
+    bool parse_array_reply(Buffer& rsp, msize_t& count, Buffer::iterator& elements_begin)
+    {
+        try {
+            Buffer::iterator i = rsp.begin();
+            if (i == rsp.end() || *i != '*') {
+                return false;
+            }
+            auto r = msg::btou(++i, rsp.end());
+            count = r.first;
+            elements_begin = r.second;
+            return true;
+        } catch (msg::MessageInterrupted&) {
+            return false;
+        }
+    }
+
     class OneSlotCommand
         : public DataCommand
     {
-        slot const key_slot;
+        slot const _key_slot;
+        bool const _streamable;
     public:
-        OneSlotCommand(Buffer b, util::sref<CommandGroup> g, slot ks)
+        OneSlotCommand(Buffer b, util::sref<CommandGroup> g, slot ks, bool streamable=false)
             : DataCommand(std::move(b), g)
-            , key_slot(ks)
+            , _key_slot(ks)
+            , _streamable(streamable)
+        {
+            LOG(DEBUG) << "-Keyslot = " << this->_key_slot;
+        }
+
+        bool reply_streamable() const
         {
-            LOG(DEBUG) << "-Keyslot = " << this->key_slot;
+            return this->_streamable;
         }
 
         Server* select_server(Proxy* proxy)
         {
-            return ::select_server_for(proxy, this, this->key_slot);
+            return ::select_server_for(proxy, this, this->_key_slot);
+        }
+
+        slot key_slot() const
+        {
+            return this->_key_slot;
+        }
+    };
+
+    /* reads of keys under compress-prefixes */
+    class DecompressCommand
+        : public OneSlotCommand
+    {
+    public:
+        DecompressCommand(Buffer b, util::sref<CommandGroup> g, slot ks)
+            : OneSlotCommand(std::move(b), g, ks)
+        {}
+
+        void on_remote_responsed(Buffer rsp, bool error)
+        {
+            if (!error) {
+                decompress_reply(rsp);
+            }
+            OneSlotCommand::on_remote_responsed(std::move(rsp), error);
+        }
+    };
+
+    /* a request passed on as it arrives; the part written is not kept */
+    class StreamedRequestCommand
+        : public OneSlotCommand
+    {
+    public:
+        StreamedRequestCommand(util::sref<CommandGroup> g, slot ks)
+            : OneSlotCommand(Buffer(), g, ks, true)
+        {}
+
+        bool retriable() const
+        {
+            return false;
         }
     };
 
+    bool compress_arg(Buffer::iterator begin, Buffer::iterator end, std::string& out)
+    {
+        return begin != end && compress_value(
+            reinterpret_cast<char const*>(&*begin), end - begin, out);
+    }
+
     class MultiStepsCommand
         : public DataCommand
     {
@@ -71,6 +163,11 @@ namespace {
             return ::select_server_for(proxy, this, this->current_key_slot);
         }
 
+        slot key_slot() const
+        {
+            return this->current_key_slot;
+        }
+
         void on_remote_responsed(Buffer rsp, bool error)
         {
             on_rsp(std::move(rsp), error);
@@ -135,11 +232,9 @@ namespace {
     protected:
         explicit StatsCommandGroup(util::sref<Client> cli)
             : CommandGroup(cli)
-            , creation(Clock::now())
             , complete(false)
         {}
 
-        Time const creation;
         bool complete;
 
         bool wait_remote() const
@@ -167,9 +262,10 @@ namespace {
             , command(nullptr)
         {}
 
+        /* the reply is forwarded as it is, so it could be streamed */
         SingleCommandGroup(util::sref<Client> cli, Buffer b, slot ks)
             : StatsCommandGroup(cli)
-            , command(new OneSlotCommand(std::move(b), util::mkref(*this), ks))
+            , command(new OneSlotCommand(std::move(b), util::mkref(*this), ks, true))
         {}
 
         void command_responsed()
@@ -202,6 +298,54 @@ namespace {
     class MultipleCommandsGroup
         : public StatsCommandGroup
     {
+        /*
+         * If there are more commands than fanout-window, at most that many
+         * are in flight to each node; the rest wait in the queue of the
+         * node, and one is sent each time one in flight is replied
+         */
+        struct NodeWindow {
+            std::deque<util::sref<DataCommand>> pending;
+            std::deque<util::sref<DataCommand>> in_flight;
+        };
+        std::vector<NodeWindow> _windows;
+        Proxy* _proxy;
+
+        void _send_pending(NodeWindow& w)
+        {
+            while (!w.pending.empty() && w.in_flight.size() < cerb_global::fanout_window) {
+                util::sref<DataCommand> c = w.pending.front();
+                w.pending.pop_front();
+                w.in_flight.push_back(c);
+                Server* s = c->select_server(this->_proxy);
+                if (s != nullptr) {
+                    this->_proxy->set_conn_poll_rw(s);
+                }
+            }
+        }
+
+        void _select_windowed(Proxy* proxy)
+        {
+            this->_proxy = proxy;
+            std::map<Server*, msize_t> node_windows;
+            for (auto& c: this->commands) {
+                Server* s = proxy->get_server_by_slot(c->key_slot());
+                if (s == nullptr) {
+                    /* retried after the slot map is updated */
+                    c->select_server(proxy);
+                    continue;
+                }
+                auto i = node_windows.find(s);
+                if (i == node_windows.end()) {
+                    i = node_windows.insert(std::make_pair(s, this->_windows.size())).first;
+                    this->_windows.push_back(NodeWindow());
+                }
+                this->_windows[i->second].pending.push_back(*c);
+            }
+            for (NodeWindow& w: this->_windows) {
+                this->_send_pending(w);
+            }
+            cerb_global::thread_stats.add(STAT_FANOUT_WINDOWED, 1);
+        }
     public:
         std::shared_ptr<Buffer> arr_payload;
         std::vector<util::sptr<DataCommand>> commands;
@@ -209,10 +353,33 @@ namespace {
 
         explicit MultipleCommandsGroup(util::sref<Client> c)
             : StatsCommandGroup(c)
+            , _proxy(nullptr)
             , arr_payload(new Buffer)
             , awaiting_count(0)
         {}
 
+        void command_replied(util::sref<Command> c)
+        {
+            auto replied = [&](util::sref<DataCommand> f)
+            {
+                return f.convert<Command>().is(c);
+            };
+            /* replies of a node come in order, unless a command is retried */
+            for (NodeWindow& w: this->_windows) {
+                if (!w.in_flight.empty() && replied(w.in_flight.front())) {
+                    w.in_flight.pop_front();
+                    return this->_send_pending(w);
+                }
+            }
+            for (NodeWindow& w: this->_windows) {
+                auto i = std::find_if(w.in_flight.begin(), w.in_flight.end(), replied);
+                if (i != w.in_flight.end()) {
+                    w.in_flight.erase(i);
+                    return this->_send_pending(w);
+                }
+            }
+        }
+
         void append_command(util::sptr<DataCommand> c)
         {
             awaiting_count += 1;
@@ -237,6 +404,15 @@ namespace {
             }
         }
 
+        /*
+         * commands held in windows would be sent after commands of later
+         * groups to the same nodes, so those groups wait
+         */
+        bool holds_pipeline() const
+        {
+            return !this->_windows.empty() && !this->complete;
+        }
+
         int total_buffer_size() const
         {
             int i = this->arr_payload->size();
@@ -248,6 +424,11 @@ namespace {
 
         void select_remote(Proxy* proxy)
         {
+            if (cerb_global::fanout_window != 0 &&
+                this->commands.size() > cerb_global::fanout_window)
+            {
+                return this->_select_windowed(proxy);
+            }
             for (auto& c: this->commands) {
                 c->select_server(proxy);
             }
@@ -357,6 +538,163 @@ namespace {
         void on_str(Buffer::iterator, Buffer::iterator) {}
     };
 
+    /* the reply to PROXY BULK END, made after all commands before it are done */
+    class BulkSummaryGroup
+        : public CommandGroup
+    {
+        std::shared_ptr<BulkIngest> const bulk;
+        std::shared_ptr<Buffer> reply;
+    public:
+        BulkSummaryGroup(util::sref<Client> c, std::shared_ptr<BulkIngest> b)
+            : CommandGroup(c)
+            , bulk(std::move(b))
+            , reply(new Buffer)
+        {}
+
+        bool wait_remote() const
+        {
+            return false;
+        }
+
+        void select_remote(Proxy*) {}
+        void command_responsed() {}
+
+        void append_buffer_to(BufferSet& b)
+        {
+            std::string r(fmt::format("*5\r\n$2\r\nok\r\n:{}\r\n$6\r\nerrors\r\n:{}\r\n*{}\r\n",
+                                      this->bulk->ok, this->bulk->errors,
+                                      this->bulk->first_errors.size()));
+            for (std::string const& e: this->bulk->first_errors) {
+                r += fmt::format("${}\r\n{}\r\n", e.size(), e);
+            }
+            this->reply->swap(Buffer(r));
+            b.append(this->reply);
+        }
+
+        int total_buffer_size() const
+        {
+            return this->reply->size();
+        }
+    };
+
+    std::set<std::string> const PROXY_SUBCOMMANDS({"TRACE", "SLOTSTATS", "NOREPLY", "BULK"});
+
+    /* PROXY with no or other arguments shows stats, as INFO does */
+    class ProxyCommandParser
+        : public SpecialCommandParser
+    {
+        std::vector<std::string> args;
+    public:
+        ProxyCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.empty()) {
+                return util::mkptr(new DirectCommandGroup(c, stats_string()));
+            }
+            std::string subcmd(this->args[0]);
+            std::transform(subcmd.begin(), subcmd.end(), subcmd.begin(), ::toupper);
+            if (subcmd == "TRACE" && this->args.size() <= 2) {
+                msize_t count = cerb_global::trace_max_len;
+                if (this->args.size() == 2) {
+                    try {
+                        int n = util::atoi(this->args[1]);
+                        count = n < 0 ? msize_t(-1) : msize_t(n);
+                    } catch (BadRedisMessage&) {
+                        return util::mkptr(new DirectCommandGroup(
+                            c, "-ERR value is not an integer or out of range\r\n"));
+                    }
+                }
+                std::string json(trace_chrome_json(count));
+                return util::mkptr(new DirectCommandGroup(
+                    c, fmt::format("${}\r\n{}\r\n", json.size(), json)));
+            }
+            if (subcmd == "SLOTSTATS" && this->args.size() <= 2) {
+                msize_t top = 10;
+                if (this->args.size() == 2) {
+                    try {
+                        int n = util::atoi(this->args[1]);
+                        top = n < 0 ? msize_t(-1) : msize_t(n);
+                    } catch (BadRedisMessage&) {
+                        return util::mkptr(new DirectCommandGroup(
+                            c, "-ERR value is not an integer or out of range\r\n"));
+                    }
+                }
+                return util::mkptr(new DirectCommandGroup(
+                    c, slot_stats_report(c->proxy(), top)));
+            }
+            if (subcmd == "NOREPLY" && this->args.size() == 2) {
+                if (util::strnieq(this->args[1], "ON", 3)) {
+                    c->noreply = true;
+                    return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+                }
+                if (util::strnieq(this->args[1], "OFF", 4)) {
+                    c->noreply = false;
+                    return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+                }
+            }
+            if (subcmd == "BULK" && this->args.size() == 1) {
+                if (c->bulk) {
+                    return util::mkptr(new DirectCommandGroup(c, "-ERR already in bulk mode\r\n"));
+                }
+                c->bulk = std::make_shared<BulkIngest>();
+                return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+            }
+            if (subcmd == "BULK" && this->args.size() == 2 &&
+                util::strnieq(this->args[1], "END", 4))
+            {
+                if (!c->bulk) {
+                    return util::mkptr(new DirectCommandGroup(c, "-ERR not in bulk mode\r\n"));
+                }
+                util::sptr<CommandGroup> g(new BulkSummaryGroup(c, std::move(c->bulk)));
+                c->bulk.reset();
+                return std::move(g);
+            }
+            if (PROXY_SUBCOMMANDS.find(subcmd) != PROXY_SUBCOMMANDS.end()) {
+                return util::mkptr(new DirectCommandGroup(c, fmt::format(
+                    "-ERR wrong arguments for 'proxy {}' command\r\n", this->args[0])));
+            }
+            return util::mkptr(new DirectCommandGroup(c, stats_string()));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    class ClientCommandParser
+        : public SpecialCommandParser
+    {
+        std::vector<std::string> args;
+    public:
+        ClientCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.empty()) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'client' command\r\n"));
+            }
+            std::string subcmd(this->args[0]);
+            std::transform(subcmd.begin(), subcmd.end(), subcmd.begin(), ::toupper);
+            if (subcmd == "LIST" && this->args.size() == 1) {
+                return util::mkptr(new DirectCommandGroup(c, client_list()));
+            }
+            if (subcmd == "KILL" && this->args.size() > 1) {
+                return util::mkptr(new DirectCommandGroup(c, client_kill(
+                    std::vector<std::string>(this->args.begin() + 1, this->args.end()))));
+            }
+            return util::mkptr(new DirectCommandGroup(
+                c, "-ERR Unknown CLIENT subcommand or wrong number of arguments\r\n"));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
     class UpdateSlotMapCommandParser
         : public SpecialCommandParser
     {
@@ -372,6 +710,52 @@ namespace {
         void on_str(Buffer::iterator, Buffer::iterator) {}
     };
 
+    class SlowLogCommandParser
+        : public SpecialCommandParser
+    {
+        std::vector<std::string> args;
+    public:
+        SlowLogCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.empty()) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'slowlog' command\r\n"));
+            }
+            std::string subcmd(this->args[0]);
+            std::transform(subcmd.begin(), subcmd.end(), subcmd.begin(), ::toupper);
+            if (subcmd == "GET" && this->args.size() <= 2) {
+                msize_t count = 10;
+                if (this->args.size() == 2) {
+                    try {
+                        int n = util::atoi(this->args[1]);
+                        count = n < 0 ? msize_t(-1) : msize_t(n);
+                    } catch (BadRedisMessage&) {
+                        return util::mkptr(new DirectCommandGroup(
+                            c, "-ERR value is not an integer or out of range\r\n"));
+                    }
+                }
+                return util::mkptr(new DirectCommandGroup(c, slowlog_get(count)));
+            }
+            if (subcmd == "LEN" && this->args.size() == 1) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, ':' + util::str(slowlog_len()) + "\r\n"));
+            }
+            if (subcmd == "RESET" && this->args.size() == 1) {
+                slowlog_reset();
+                return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+            }
+            return util::mkptr(new DirectCommandGroup(
+                c, "-ERR Unknown SLOWLOG subcommand or wrong number of arguments\r\n"));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
     class SetRemotesCommandParser
         : public SpecialCommandParser
     {
@@ -415,6 +799,20 @@ namespace {
         }
     };
 
+    /* whether a command of this many keys is refused by max-fanout-keys */
+    bool too_many_keys(msize_t keys)
+    {
+        return cerb_global::max_fanout_keys != 0 && keys > cerb_global::max_fanout_keys;
+    }
+
+    util::sptr<CommandGroup> too_many_keys_error(util::sref<Client> c, std::string const& cmd)
+    {
+        cerb_global::thread_stats.add(STAT_FANOUT_REJECTED, 1);
+        return util::mkptr(new DirectCommandGroup(c, fmt::format(
+            "-ERR too many keys for '{}' command, at most {}\r\n",
+            cmd, cerb_global::max_fanout_keys)));
+    }
+
     class EachKeyCommandParser
         : public SpecialCommandParser
     {
@@ -428,6 +826,12 @@ namespace {
         {
             return util::mkptr(new MultipleCommandsGroup(c));
         }
+
+        virtual util::sptr<DataCommand> make_command(
+            Buffer b, util::sref<CommandGroup> g, slot ks, msize_t) const
+        {
+            return util::mkptr(new OneSlotCommand(std::move(b), g, ks));
+        }
     public:
         EachKeyCommandParser(Buffer::iterator arg_begin, std::string cmd)
             : command_name(std::move(cmd))
@@ -452,12 +856,15 @@ namespace {
                 return util::mkptr(new DirectCommandGroup(
                     c, "-ERR wrong number of arguments for '" + this->command_name + "' command\r\n"));
             }
+            if (::too_many_keys(keys_slots.size())) {
+                return ::too_many_keys_error(c, this->command_name);
+            }
             util::sptr<MultipleCommandsGroup> g(this->makeGroup(c));
             for (unsigned i = 0; i < keys_slots.size(); ++i) {
                 Buffer b(command_header());
                 b.append_from(this->keys_split_points[i], this->keys_split_points[i + 1]);
-                g->append_command(util::mkptr(
-                    new OneSlotCommand(std::move(b), *g, this->keys_slots[i])));
+                g->append_command(this->make_command(
+                    std::move(b), *g, this->keys_slots[i], i));
             }
             return std::move(g);
         }
@@ -466,14 +873,34 @@ namespace {
     class MGetCommandParser
         : public EachKeyCommandParser
     {
+        /* filled only if compress-prefixes is set */
+        std::vector<bool> keys_compressed;
+
         Buffer command_header() const
         {
             return Buffer("*2\r\n$3\r\nGET\r\n");
         }
+
+        util::sptr<DataCommand> make_command(
+            Buffer b, util::sref<CommandGroup> g, slot ks, msize_t i) const
+        {
+            if (i < this->keys_compressed.size() && this->keys_compressed[i]) {
+                return util::mkptr(new DecompressCommand(std::move(b), g, ks));
+            }
+            return util::mkptr(new OneSlotCommand(std::move(b), g, ks));
+        }
     public:
         explicit MGetCommandParser(Buffer::iterator arg_begin)
             : EachKeyCommandParser(arg_begin, "mget")
         {}
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            if (!cerb_global::compress_prefixes.empty()) {
+                this->keys_compressed.push_back(compress_key(std::string(begin, end)));
+            }
+            EachKeyCommandParser::on_str(begin, end);
+        }
     };
 
     class DelCommandParser
@@ -543,6 +970,9 @@ namespace {
         std::vector<Buffer::iterator> kv_split_points;
         std::vector<slot> keys_slots;
         bool current_is_key;
+        /* keys and values, kept only if compress-prefixes is set */
+        std::vector<std::string> keys;
+        std::vector<std::pair<Buffer::iterator, Buffer::iterator>> values;
     public:
         explicit MSetCommandParser(Buffer::iterator arg_begin)
             : current_is_key(true)
@@ -552,10 +982,17 @@ namespace {
 
         void on_str(Buffer::iterator begin, Buffer::iterator end)
         {
+            if (!cerb_global::compress_prefixes.empty()) {
+                if (this->current_is_key) {
+                    this->keys.push_back(std::string(begin, end));
+                } else {
+                    this->values.push_back(std::make_pair(begin, end));
+                }
+            }
             if (this->current_is_key) {
                 KeySlotCalc slot_calc;
-                for (; begin != end; ++begin) {
-                    slot_calc.next_byte(*begin);
+                for (Buffer::iterator i = begin; i != end; ++i) {
+                    slot_calc.next_byte(*i);
                 }
                 this->keys_slots.push_back(slot_calc.get_slot());
             }
@@ -570,8 +1007,20 @@ namespace {
                 return util::mkptr(new DirectCommandGroup(
                     c, "-ERR wrong number of arguments for 'mset' command\r\n"));
             }
+            if (::too_many_keys(keys_slots.size())) {
+                return ::too_many_keys_error(c, "mset");
+            }
             util::sptr<MSetCommandGroup> g(new MSetCommandGroup(c));
             for (unsigned i = 0; i < keys_slots.size(); ++i) {
+                std::string compressed;
+                if (!this->keys.empty() && compress_key(this->keys[i]) && ::compress_arg(
+                        this->values[i].first, this->values[i].second, compressed))
+                {
+                    g->append_command(util::mkptr(new OneSlotCommand(
+                        Buffer(msg::format_command("SET", {this->keys[i], compressed})),
+                        *g, keys_slots[i])));
+                    continue;
+                }
                 Buffer b("*3\r\n$3\r\nSET\r\n");
                 b.append_from(kv_split_points[i * 2], kv_split_points[i * 2 + 2]);
                 g->append_command(util::mkptr(new OneSlotCommand(
@@ -581,68 +1030,132 @@ namespace {
         }
     };
 
+    /*
+     * RENAME or RENAMENX of keys in different slots: DUMP and PTTL the
+     * source in a transaction, RESTORE the destination with the TTL, then
+     * DEL the source; it works for any type and keeps the expiry, though
+     * without atomicity
+     */
     class RenameCommandParser
         : public SpecialCommandParser
     {
         class RenameCommand
             : public MultiStepsCommand
         {
-            Buffer old_key;
-            Buffer new_key;
-            slot old_key_slot;
-            slot new_key_slot;
+            std::string const old_key;
+            std::string const new_key;
+            slot const old_key_slot;
+            slot const new_key_slot;
+            bool const nx;
+            msize_t leading;
+
+            void fail(Buffer rsp)
+            {
+                this->leading = 0;
+                this->buffer->swap(rsp);
+                this->responsed();
+            }
+
+            /* the replies of DUMP and PTTL in the array replied by EXEC */
+            static bool parse_dump(Buffer& rsp, bool& exists, std::string& dump,
+                                   int64_t& pttl)
+            {
+                msize_t count;
+                Buffer::iterator i;
+                if (!::parse_array_reply(rsp, count, i) || count != 2) {
+                    return false;
+                }
+                try {
+                    if (i == rsp.end() || *i != '$') {
+                        return false;
+                    }
+                    auto r = msg::btoi(i + 1, rsp.end());
+                    exists = r.first >= 0;
+                    i = r.second;
+                    if (exists) {
+                        i = msg::parse_str(r.first, r.second, rsp.end());
+                        dump = std::string(r.second, i - msg::LENGTH_OF_CR_LF);
+                    }
+                    if (i == rsp.end() || *i != ':') {
+                        return false;
+                    }
+                    pttl = msg::btoi(i + 1, rsp.end()).first;
+                    return true;
+                } catch (msg::MessageInterrupted&) {
+                    return false;
+                }
+            }
         public:
-            RenameCommand(Buffer old_key, Buffer new_key, slot old_key_slot,
-                          slot new_key_slot, util::sref<CommandGroup> group)
+            RenameCommand(std::string old_key, std::string new_key, slot old_key_slot,
+                          slot new_key_slot, bool nx, util::sref<CommandGroup> group)
                 : MultiStepsCommand(group, old_key_slot,
                                     [&](Buffer r, bool e)
                                     {
-                                        return this->rsp_get(std::move(r), e);
+                                        return this->rsp_dump(std::move(r), e);
                                     })
                 , old_key(std::move(old_key))
                 , new_key(std::move(new_key))
                 , old_key_slot(old_key_slot)
                 , new_key_slot(new_key_slot)
+                , nx(nx)
+                , leading(3)
+            {
+                std::vector<std::string> key(1, this->old_key);
+                this->buffer->swap(Buffer(MULTI_CMD + msg::format_command("DUMP", key)
+                                          + msg::format_command("PTTL", key) + EXEC_CMD));
+            }
+
+            msize_t leading_replies() const
             {
-                this->buffer->swap(Buffer("*2\r\n$3\r\nGET\r\n"));
-                this->buffer->append_from(this->old_key.begin(), this->old_key.end());
+                return this->leading;
             }
 
-            void rsp_get(Buffer rsp, bool error)
+            void rsp_dump(Buffer rsp, bool error)
             {
                 if (error) {
-                    this->buffer->swap(rsp);
-                    return this->responsed();
+                    return this->fail(std::move(rsp));
+                }
+                bool exists;
+                std::string dump;
+                int64_t pttl;
+                if (!parse_dump(rsp, exists, dump, pttl)) {
+                    return this->fail(Buffer("-ERR unexpected reply from node\r\n"));
                 }
-                if (rsp.same_as_string("$-1\r\n")) {
-                    this->buffer->swap(Buffer("-ERR no such key\r\n"));
-                    return this->responsed();
+                if (!exists) {
+                    return this->fail(Buffer("-ERR no such key\r\n"));
                 }
-                this->buffer->swap(Buffer("*3\r\n$3\r\nSET\r\n"));
-                this->buffer->append_from(new_key.begin(), new_key.end());
-                this->buffer->append_from(rsp.begin(), rsp.end());
-                this->current_key_slot = new_key_slot;
+                std::vector<std::string> args({
+                    this->new_key, util::str(std::max(pttl, int64_t(0))), std::move(dump)});
+                if (!this->nx) {
+                    args.push_back("REPLACE");
+                }
+                this->leading = 0;
+                this->buffer->swap(Buffer(msg::format_command("RESTORE", args)));
+                this->current_key_slot = this->new_key_slot;
                 this->on_rsp =
                     [this](Buffer rsp, bool error)
                     {
                         if (error) {
-                            this->buffer->swap(rsp);
-                            return this->responsed();
+                            if (this->nx && util::stristartswith(rsp.to_string(), "-BUSYKEY")) {
+                                return this->fail(Buffer(":0\r\n"));
+                            }
+                            return this->fail(std::move(rsp));
                         }
-                        this->rsp_set();
+                        this->rsp_restore();
                     };
                 this->group->client->reactivate(util::mkref(*this));
             }
 
-            void rsp_set()
+            /* the source is deleted only after the destination is restored */
+            void rsp_restore()
             {
-                this->buffer->swap(Buffer("*2\r\n$3\r\nDEL\r\n"));
-                this->buffer->append_from(old_key.begin(), old_key.end());
-                this->current_key_slot = old_key_slot;
+                this->buffer->swap(Buffer(msg::format_command(
+                    "DEL", std::vector<std::string>(1, this->old_key))));
+                this->current_key_slot = this->old_key_slot;
                 this->on_rsp =
                     [this](Buffer, bool)
                     {
-                        this->buffer->swap(Buffer(RSP_OK_STR));
+                        this->buffer->swap(Buffer(this->nx ? ":1\r\n" : RSP_OK_STR));
                         this->responsed();
                     };
                 this->group->client->reactivate(util::mkref(*this));
@@ -650,52 +1163,45 @@ namespace {
         };
 
         Buffer::iterator command_begin;
-        std::vector<Buffer::iterator> split_points;
+        bool const nx;
+        std::vector<std::string> keys;
         KeySlotCalc key_slot[2];
-        int slot_index;
-        bool bad;
     public:
-        RenameCommandParser(Buffer::iterator cmd_begin,
-                            Buffer::iterator arg_begin)
+        RenameCommandParser(Buffer::iterator cmd_begin, bool nx)
             : command_begin(cmd_begin)
-            , slot_index(0)
-            , bad(false)
-        {
-            split_points.push_back(arg_begin);
-        }
+            , nx(nx)
+        {}
 
         void on_str(Buffer::iterator begin, Buffer::iterator end)
         {
-            if (this->slot_index == 2) {
-                this->bad = true;
-                return;
-            }
-            for (; begin != end; ++begin) {
-                this->key_slot[this->slot_index].next_byte(*begin);
+            if (this->keys.size() < 2) {
+                std::for_each(begin, end, [&](byte b)
+                              {
+                                  this->key_slot[this->keys.size()].next_byte(b);
+                              });
             }
-            this->split_points.push_back(end + msg::LENGTH_OF_CR_LF);
-            ++this->slot_index;
+            this->keys.push_back(std::string(begin, end));
         }
 
         util::sptr<CommandGroup> spawn_commands(
-            util::sref<Client> c, Buffer::iterator)
+            util::sref<Client> c, Buffer::iterator end)
         {
-            if (slot_index != 2 || this->bad) {
-                return util::mkptr(new DirectCommandGroup(
-                    c, "-ERR wrong number of arguments for 'rename' command\r\n"));
+            if (this->keys.size() != 2) {
+                return util::mkptr(new DirectCommandGroup(c, fmt::format(
+                    "-ERR wrong number of arguments for '{}' command\r\n",
+                    this->nx ? "renamenx" : "rename")));
             }
             slot src_slot = key_slot[0].get_slot();
             slot dst_slot = key_slot[1].get_slot();
             LOG(DEBUG) << "#Rename slots: " << src_slot << " - " << dst_slot;
             if (src_slot == dst_slot) {
                 return util::mkptr(new SingleCommandGroup(
-                    c, Buffer(command_begin, split_points[2]), src_slot));
+                    c, Buffer(command_begin, end), src_slot));
             }
             util::sptr<SingleCommandGroup> g(new SingleCommandGroup(c));
             g->command = util::mkptr(new RenameCommand(
-                Buffer(split_points[0], split_points[1]),
-                Buffer(split_points[1], split_points[2]),
-                src_slot, dst_slot, *g));
+                std::move(this->keys[0]), std::move(this->keys[1]),
+                src_slot, dst_slot, this->nx, *g));
             return std::move(g);
         }
     };
@@ -749,6 +1255,67 @@ namespace {
         }
     };
 
+    class MonitorCommandParser
+        : public SpecialCommandParser
+    {
+        class MonitorGroup
+            : public LongCommandGroup
+        {
+            msize_t const sample_rate;
+            std::string const pattern;
+        public:
+            MonitorGroup(util::sref<Client> client, msize_t rate, std::string p)
+                : LongCommandGroup(client)
+                , sample_rate(rate)
+                , pattern(std::move(p))
+            {}
+
+            void deliver_client(Proxy* p)
+            {
+                int sink = Monitor::attach(this->sample_rate);
+                if (sink == -1) {
+                    flush_string(this->client->fd, "-ERR too many monitors\r\n");
+                    return this->client->close();
+                }
+                new Monitor(p, this->client->fd, sink, this->pattern);
+                LOG(DEBUG) << "Convert " << this->client->str() << " as monitor";
+                this->client->fd = -1;
+            }
+        };
+
+        std::vector<std::string> args;
+    public:
+        MonitorCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.size() > 2) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'monitor' command\r\n"));
+            }
+            msize_t rate = 1;
+            if (!this->args.empty()) {
+                try {
+                    int n = util::atoi(this->args[0]);
+                    if (n <= 0) {
+                        throw BadRedisMessage("sample rate is not positive");
+                    }
+                    rate = n;
+                } catch (BadRedisMessage&) {
+                    return util::mkptr(new DirectCommandGroup(
+                        c, "-ERR sample rate should be a positive integer\r\n"));
+                }
+            }
+            return util::mkptr(new MonitorGroup(
+                c, rate, this->args.size() == 2 ? this->args[1] : ""));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
     class BlockedListPopParser
         : public SpecialCommandParser
     {
@@ -911,16 +1478,1535 @@ namespace {
         }
     };
 
-    using CmdPtr = util::sptr<SpecialCommandParser>;
-    using CmdCreateFn = CmdPtr(*)(Buffer::iterator, Buffer::iterator);
-    std::map<std::string, CmdCreateFn> SPECIAL_RSP(
+    /*
+     * Base of groups that send commands to nodes of the slot map, each node
+     * addressed by its first slot. If the slot map of the thread is not
+     * retrieved yet, a placeholder command waits in the retrying queue of
+     * the proxy, and the group starts when it is retried.
+     */
+    class NodesCommandGroup
+        : public StatsCommandGroup
     {
-        {"PING",
-            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
-            {
-                return util::mkptr(new PingCommandParser);
-            }},
-        {"INFO",
+    protected:
+        class NodeCommand
+            : public DataCommand
+        {
+            NodesCommandGroup* const owner;
+        public:
+            slot node_slot;
+            Server* server;
+            bool awaiting;
+            msize_t leading;
+
+            explicit NodeCommand(NodesCommandGroup* g)
+                : DataCommand(util::mkref(*g))
+                , owner(g)
+                , node_slot(0)
+                , server(nullptr)
+                , awaiting(false)
+                , leading(0)
+            {}
+
+            Server* select_server(Proxy* proxy)
+            {
+                if (this->owner->nodes.empty()) {
+                    this->owner->start(proxy, true);
+                    return proxy->get_server_by_slot(this->node_slot);
+                }
+                this->server = ::select_server_for(proxy, this, this->node_slot);
+                return this->server;
+            }
+
+            slot key_slot() const
+            {
+                return this->node_slot;
+            }
+
+            msize_t leading_replies() const
+            {
+                return this->leading;
+            }
+
+            void on_leading_reply(Buffer const& rsp, bool moved)
+            {
+                if (this->awaiting) {
+                    this->owner->node_leading_reply(rsp, moved);
+                }
+            }
+
+            void on_remote_responsed(Buffer rsp, bool)
+            {
+                if (!this->awaiting) {
+                    return;
+                }
+                this->awaiting = false;
+                --this->owner->awaiting;
+                if (this->owner->nodes.empty()) {
+                    /* the placeholder fails to wait for the slot map */
+                    return this->owner->finish(std::move(rsp));
+                }
+                this->buffer->swap(rsp);
+                this->owner->node_responsed(util::mkref(*this));
+            }
+        };
+
+        std::vector<slot> nodes;
+        std::vector<util::sptr<NodeCommand>> node_commands;
+        msize_t awaiting;
+        std::shared_ptr<Buffer> reply;
+
+        explicit NodesCommandGroup(util::sref<Client> c)
+            : StatsCommandGroup(c)
+            , awaiting(0)
+            , reply(new Buffer)
+        {}
+
+        virtual void on_nodes(bool reactivate) = 0;
+        virtual void node_responsed(util::sref<NodeCommand> c) = 0;
+        virtual void node_leading_reply(Buffer const&, bool) {}
+
+        void start(Proxy* proxy, bool retried)
+        {
+            this->nodes = proxy->node_slots();
+            if (this->nodes.empty()) {
+                if (retried) {
+                    return this->finish(Buffer("-CLUSTERDOWN The cluster is down\r\n"));
+                }
+                this->node_commands.push_back(util::mkptr(new NodeCommand(this)));
+                this->node_commands[0]->awaiting = true;
+                this->awaiting = 1;
+                return proxy->retry_move_ask_command_later(*this->node_commands[0]);
+            }
+            if (retried) {
+                this->node_commands[0]->awaiting = false;
+                this->awaiting = 0;
+            }
+            this->on_nodes(retried);
+        }
+
+        /*
+         * send cmd to the node of node_slot, with the i-th command object;
+         * the node replies leading replies before the one to keep
+         */
+        void send(msize_t i, slot node_slot, std::string const& cmd, bool reactivate,
+                  msize_t leading=0)
+        {
+            if (i == this->node_commands.size()) {
+                this->node_commands.push_back(util::mkptr(new NodeCommand(this)));
+            }
+            util::sref<NodeCommand> c(*this->node_commands[i]);
+            c->node_slot = node_slot;
+            c->buffer->swap(Buffer(cmd));
+            c->awaiting = true;
+            c->leading = leading;
+            ++this->awaiting;
+            if (reactivate) {
+                this->client->reactivate(c);
+            } else {
+                c->select_server(this->client->proxy());
+            }
+        }
+
+        /* reply r to the client, cancelling commands not responded yet */
+        void finish(Buffer r)
+        {
+            for (auto& c: this->node_commands) {
+                if (c->awaiting) {
+                    if (c->server != nullptr) {
+                        c->server->cancel_command(*c);
+                    }
+                    this->client->proxy()->cancel_retry(*c);
+                    c->awaiting = false;
+                }
+            }
+            this->awaiting = 0;
+            this->reply->swap(r);
+            this->client->group_responsed();
+            this->complete = true;
+        }
+    public:
+        void select_remote(Proxy* proxy)
+        {
+            this->start(proxy, false);
+        }
+
+        void command_responsed() {}
+
+        void append_buffer_to(BufferSet& b)
+        {
+            b.append(this->reply);
+        }
+
+        int total_buffer_size() const
+        {
+            return this->reply->size();
+        }
+
+        Interval avg_commands_remote_cost() const
+        {
+            if (this->node_commands.empty()) {
+                return Interval(0);
+            }
+            return std::accumulate(
+                this->node_commands.begin(), this->node_commands.end(), Interval(0),
+                [](Interval a, util::sptr<NodeCommand> const& c)
+                {
+                    return a + c->remote_cost();
+                }) / this->node_commands.size();
+        }
+    };
+
+    /*
+     * A cursor of the proxy is the cursor of a node shifted left by
+     * SCAN_NODE_BITS, with the index of that node in the low bits. Nodes
+     * are ordered by their first slots, so the index of a node is stable
+     * while the slot map does not change.
+     */
+    int const SCAN_NODE_BITS = 10;
+    uint64_t const SCAN_NODE_MASK = (uint64_t(1) << SCAN_NODE_BITS) - 1;
+    int const SCAN_MAX_ROUNDS = 8;
+
+    bool parse_cursor(std::string const& s, uint64_t& cursor)
+    {
+        if (s.empty() || !std::isdigit(s[0])) {
+            return false;
+        }
+        char* end;
+        errno = 0;
+        cursor = std::strtoull(s.data(), &end, 10);
+        return errno == 0 && end == s.data() + s.size();
+    }
+
+    /*
+     * Split a SCAN reply `*2 $cursor *N keys...` into the cursor, the count
+     * of keys and where the keys begin; keys are left as they are in RESP
+     */
+    bool parse_scan_reply(Buffer& rsp, uint64_t& cursor, msize_t& count,
+                          Buffer::iterator& keys_begin)
+    {
+        try {
+            Buffer::iterator i = rsp.begin();
+            if (i == rsp.end() || *i != '*') {
+                return false;
+            }
+            auto r = msg::btou(++i, rsp.end());
+            if (r.first != 2 || r.second == rsp.end() || *r.second != '$') {
+                return false;
+            }
+            r = msg::btou(r.second + 1, rsp.end());
+            Buffer::iterator cursor_end = msg::parse_str(r.first, r.second, rsp.end());
+            if (!::parse_cursor(std::string(r.second, cursor_end - msg::LENGTH_OF_CR_LF),
+                                cursor) || cursor_end == rsp.end() || *cursor_end != '*')
+            {
+                return false;
+            }
+            r = msg::btou(cursor_end + 1, rsp.end());
+            count = r.first;
+            keys_begin = r.second;
+            return true;
+        } catch (msg::MessageInterrupted&) {
+            return false;
+        }
+    }
+
+    class ScanCommandGroup
+        : public NodesCommandGroup
+    {
+        std::vector<std::string> const options;
+        msize_t const count;
+        msize_t node_index;
+        uint64_t node_cursor;
+        int rounds;
+        msize_t keys_count;
+        Buffer keys;
+
+        void scan_node(bool reactivate)
+        {
+            std::vector<std::string> args(1, fmt::format("{}", this->node_cursor));
+            args.insert(args.end(), this->options.begin(), this->options.end());
+            this->send(0, this->nodes[this->node_index],
+                       msg::format_command("SCAN", args), reactivate);
+        }
+
+        bool merge_page(Buffer& rsp)
+        {
+            if (::is_error_reply(rsp)) {
+                this->finish(std::move(rsp));
+                return false;
+            }
+            uint64_t cursor;
+            msize_t n;
+            Buffer::iterator keys_begin;
+            if (!::parse_scan_reply(rsp, cursor, n, keys_begin)) {
+                this->finish(Buffer("-ERR unexpected SCAN reply from node\r\n"));
+                return false;
+            }
+            this->keys.append_from(keys_begin, rsp.end());
+            this->keys_count += n;
+            this->node_cursor = cursor;
+            if (cursor == 0) {
+                ++this->node_index;
+            }
+            return true;
+        }
+
+        void on_nodes(bool reactivate)
+        {
+            if (this->nodes.size() > SCAN_NODE_MASK + 1) {
+                return this->finish(Buffer("-ERR too many nodes to scan\r\n"));
+            }
+            if (this->node_index >= this->nodes.size()) {
+                return this->finish(Buffer("-ERR invalid cursor\r\n"));
+            }
+            this->scan_node(reactivate);
+        }
+
+        void node_responsed(util::sref<NodeCommand> c)
+        {
+            if (!this->merge_page(*c->buffer)) {
+                return;
+            }
+            bool done = this->node_index == this->nodes.size();
+            if (!done && this->keys_count < this->count &&
+                ++this->rounds < SCAN_MAX_ROUNDS)
+            {
+                return this->scan_node(true);
+            }
+            if (this->node_cursor > (~uint64_t(0) >> SCAN_NODE_BITS)) {
+                return this->finish(Buffer("-ERR node cursor out of range\r\n"));
+            }
+            std::string cursor(fmt::format("{}", done ? 0 : (
+                this->node_cursor << SCAN_NODE_BITS | this->node_index)));
+            Buffer r(fmt::format("*2\r\n${}\r\n{}\r\n*{}\r\n", cursor.size(), cursor,
+                                 this->keys_count));
+            r.append_from(this->keys.begin(), this->keys.end());
+            this->finish(std::move(r));
+        }
+    public:
+        ScanCommandGroup(util::sref<Client> c, uint64_t cursor,
+                         std::vector<std::string> opts, msize_t count)
+            : NodesCommandGroup(c)
+            , options(std::move(opts))
+            , count(count)
+            , node_index(cursor & SCAN_NODE_MASK)
+            , node_cursor(cursor >> SCAN_NODE_BITS)
+            , rounds(0)
+            , keys_count(0)
+        {}
+    };
+
+    class ScanCommandParser
+        : public SpecialCommandParser
+    {
+        std::vector<std::string> args;
+    public:
+        ScanCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.empty()) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'scan' command\r\n"));
+            }
+            uint64_t cursor;
+            if (!::parse_cursor(this->args[0], cursor)) {
+                return util::mkptr(new DirectCommandGroup(c, "-ERR invalid cursor\r\n"));
+            }
+            msize_t count = 10;
+            for (msize_t i = 1; i < this->args.size(); i += 2) {
+                std::string opt(this->args[i]);
+                std::transform(opt.begin(), opt.end(), opt.begin(), ::toupper);
+                if (i + 1 == this->args.size() ||
+                    (opt != "MATCH" && opt != "COUNT" && opt != "TYPE"))
+                {
+                    return util::mkptr(new DirectCommandGroup(c, "-ERR syntax error\r\n"));
+                }
+                if (opt == "COUNT") {
+                    try {
+                        int n = util::atoi(this->args[i + 1]);
+                        if (n <= 0) {
+                            return util::mkptr(new DirectCommandGroup(
+                                c, "-ERR syntax error\r\n"));
+                        }
+                        count = n;
+                    } catch (BadRedisMessage&) {
+                        return util::mkptr(new DirectCommandGroup(
+                            c, "-ERR value is not an integer or out of range\r\n"));
+                    }
+                }
+            }
+            return util::mkptr(new ScanCommandGroup(c, cursor, std::vector<std::string>(
+                this->args.begin() + 1, this->args.end()), count));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    enum ScatterReduce {
+        REDUCE_SUM,
+        REDUCE_CONCAT,
+        REDUCE_FIRST_NON_NIL,
+        REDUCE_ALL_OK,
+    };
+
+    /*
+     * Send a command to every node at the same time and combine the
+     * replies. An error reply, or the first non-nil reply for
+     * REDUCE_FIRST_NON_NIL, is replied at once and the rest are cancelled.
+     */
+    class ScatterCommandGroup
+        : public NodesCommandGroup
+    {
+        std::string const command;
+        ScatterReduce const reduce;
+        int64_t sum;
+        msize_t elements_count;
+        Buffer elements;
+
+        void on_nodes(bool reactivate)
+        {
+            for (msize_t i = 0; i < this->nodes.size(); ++i) {
+                this->send(i, this->nodes[i], this->command, reactivate);
+            }
+        }
+
+        void node_responsed(util::sref<NodeCommand> c)
+        {
+            Buffer& rsp = *c->buffer;
+            if (::is_error_reply(rsp)) {
+                return this->finish(std::move(rsp));
+            }
+            switch (this->reduce) {
+            case REDUCE_SUM:
+                if (rsp.size() == 0 || *rsp.begin() != ':') {
+                    return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                }
+                this->sum += msg::btoi(rsp.begin() + 1, rsp.end()).first;
+                break;
+            case REDUCE_CONCAT:
+                {
+                    msize_t n;
+                    Buffer::iterator elements_begin;
+                    if (!::parse_array_reply(rsp, n, elements_begin)) {
+                        return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                    }
+                    this->elements.append_from(elements_begin, rsp.end());
+                    this->elements_count += n;
+                    if (this->elements.size() > cerb_global::scatter_max_bytes) {
+                        return this->finish(Buffer(
+                            "-ERR reply from nodes exceeds scatter-max-bytes\r\n"));
+                    }
+                }
+                break;
+            case REDUCE_FIRST_NON_NIL:
+                if (!rsp.same_as_string(Response::NIL_STR)) {
+                    return this->finish(std::move(rsp));
+                }
+                break;
+            case REDUCE_ALL_OK:
+                if (!rsp.same_as_string(RSP_OK_STR)) {
+                    return this->finish(std::move(rsp));
+                }
+                break;
+            }
+            /* release the reply as soon as it is gathered */
+            rsp.swap(Buffer());
+            if (this->awaiting != 0) {
+                return;
+            }
+            switch (this->reduce) {
+            case REDUCE_SUM:
+                return this->finish(Buffer(fmt::format(":{}\r\n", this->sum)));
+            case REDUCE_CONCAT:
+                {
+                    Buffer r(fmt::format("*{}\r\n", this->elements_count));
+                    r.append_from(this->elements.begin(), this->elements.end());
+                    return this->finish(std::move(r));
+                }
+            case REDUCE_FIRST_NON_NIL:
+                return this->finish(Buffer(Response::NIL_STR));
+            case REDUCE_ALL_OK:
+                return this->finish(Buffer(RSP_OK_STR));
+            }
+        }
+    public:
+        ScatterCommandGroup(util::sref<Client> c, std::string cmd, ScatterReduce r)
+            : NodesCommandGroup(c)
+            , command(std::move(cmd))
+            , reduce(r)
+            , sum(0)
+            , elements_count(0)
+        {}
+    };
+
+    class ScatterCommandParser
+        : public SpecialCommandParser
+    {
+        std::string const command_name;
+        ScatterReduce const reduce;
+        msize_t const min_args;
+        msize_t const max_args;
+        std::vector<std::string> args;
+    public:
+        ScatterCommandParser(std::string name, ScatterReduce r,
+                             msize_t min_args, msize_t max_args)
+            : command_name(std::move(name))
+            , reduce(r)
+            , min_args(min_args)
+            , max_args(max_args)
+        {}
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.size() < this->min_args || this->max_args < this->args.size()) {
+                std::string name(this->command_name);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for '" + name + "' command\r\n"));
+            }
+            return util::mkptr(new ScatterCommandGroup(
+                c, msg::format_command(this->command_name, this->args), this->reduce));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    bool parse_bulk_reply(Buffer& rsp, std::string& s)
+    {
+        try {
+            Buffer::iterator i = rsp.begin();
+            if (i == rsp.end() || *i != '$') {
+                return false;
+            }
+            auto r = msg::btou(++i, rsp.end());
+            Buffer::iterator end = msg::parse_str(r.first, r.second, rsp.end());
+            s = std::string(r.second, end - msg::LENGTH_OF_CR_LF);
+            return true;
+        } catch (msg::MessageInterrupted&) {
+            return false;
+        }
+    }
+
+    std::string bulk_string(std::string const& s)
+    {
+        return fmt::format("${}\r\n{}\r\n", s.size(), s);
+    }
+
+    /*
+     * EVALSHA to the node of the key. If the node is not known to have the
+     * script but the proxy knows the source, EVAL the source instead, which
+     * caches the script on the node. On NOSCRIPT, retry that way once.
+     */
+    class EvalShaCommand
+        : public DataCommand
+    {
+        std::string const sha;
+        Buffer args;
+        int const argc;
+        slot const _key_slot;
+        Server* server;
+        bool with_source;
+        bool retried;
+    public:
+        EvalShaCommand(std::string sha, Buffer args, int argc, slot ks,
+                       util::sref<CommandGroup> g)
+            : DataCommand(g)
+            , sha(std::move(sha))
+            , args(std::move(args))
+            , argc(argc)
+            , _key_slot(ks)
+            , server(nullptr)
+            , with_source(false)
+            , retried(false)
+        {}
+
+        Server* select_server(Proxy* proxy)
+        {
+            Server* s = proxy->get_server_by_slot(this->_key_slot);
+            std::string source;
+            this->with_source = s != nullptr && !script_loaded_on(s->addr, this->sha)
+                                && script_source(this->sha, source);
+            this->buffer->swap(Buffer(this->with_source
+                ? fmt::format("*{}\r\n$4\r\nEVAL\r\n{}", this->argc + 2, ::bulk_string(source))
+                : fmt::format("*{}\r\n$7\r\nEVALSHA\r\n{}", this->argc + 2,
+                              ::bulk_string(this->sha))));
+            this->buffer->append_from(this->args.cbegin(), this->args.cend());
+            this->server = ::select_server_for(proxy, this, this->_key_slot);
+            return this->server;
+        }
+
+        slot key_slot() const
+        {
+            return this->_key_slot;
+        }
+
+        void on_remote_responsed(Buffer rsp, bool error)
+        {
+            if (this->server != nullptr) {
+                if (error && rsp.to_string().compare(0, 9, "-NOSCRIPT") == 0) {
+                    script_set_loaded(this->server->addr, this->sha, false);
+                    std::string source;
+                    if (!this->with_source && !this->retried &&
+                        script_source(this->sha, source))
+                    {
+                        this->retried = true;
+                        return this->group->client->reactivate(util::mkref(*this));
+                    }
+                } else if (!error && this->with_source) {
+                    script_set_loaded(this->server->addr, this->sha, true);
+                }
+            }
+            this->buffer->swap(rsp);
+            this->responsed();
+        }
+    };
+
+    class EvalShaCommandParser
+        : public SpecialCommandParser
+    {
+        std::string sha;
+        Buffer::iterator args_begin;
+        KeySlotCalc slot_calc;
+        int arg_count;
+        int key_count;
+    public:
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            switch (this->arg_count++) {
+                case 0:
+                    this->sha = std::string(begin, end);
+                    std::transform(this->sha.begin(), this->sha.end(), this->sha.begin(),
+                                   ::tolower);
+                    this->args_begin = end + msg::LENGTH_OF_CR_LF;
+                    return;
+                case 1:
+                    this->key_count = util::atoi(std::string(begin, end));
+                    return;
+                case 2:
+                    for (; begin != end; ++begin) {
+                        this->slot_calc.next_byte(*begin);
+                    }
+                    return;
+                default:
+                    return;
+            }
+        }
+
+        EvalShaCommandParser()
+            : arg_count(0)
+            , key_count(0)
+        {}
+
+        util::sptr<CommandGroup> spawn_commands(
+            util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->arg_count < 3 || this->key_count != 1) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'evalsha' command\r\n"));
+            }
+            util::sptr<SingleCommandGroup> g(new SingleCommandGroup(c));
+            g->command = util::mkptr(new EvalShaCommand(
+                std::move(this->sha), Buffer(this->args_begin, end), this->arg_count - 1,
+                this->slot_calc.get_slot(), *g));
+            return std::move(g);
+        }
+    };
+
+    /* SCRIPT LOAD to every node, recording the source and where it's loaded */
+    class ScriptLoadGroup
+        : public NodesCommandGroup
+    {
+        std::string const source;
+        std::string sha;
+
+        void on_nodes(bool reactivate)
+        {
+            std::string cmd(msg::format_command(
+                "SCRIPT", std::vector<std::string>({"LOAD", this->source})));
+            for (msize_t i = 0; i < this->nodes.size(); ++i) {
+                this->send(i, this->nodes[i], cmd, reactivate);
+            }
+        }
+
+        void node_responsed(util::sref<NodeCommand> c)
+        {
+            Buffer& rsp = *c->buffer;
+            if (::is_error_reply(rsp)) {
+                return this->finish(std::move(rsp));
+            }
+            std::string sha;
+            if (!::parse_bulk_reply(rsp, sha)) {
+                return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+            }
+            std::transform(sha.begin(), sha.end(), sha.begin(), ::tolower);
+            if (this->sha.empty()) {
+                this->sha = sha;
+                script_record(sha, this->source);
+            }
+            script_set_loaded(c->server->addr, sha, true);
+            if (this->awaiting == 0) {
+                this->finish(Buffer(::bulk_string(this->sha)));
+            }
+        }
+    public:
+        ScriptLoadGroup(util::sref<Client> c, std::string src)
+            : NodesCommandGroup(c)
+            , source(std::move(src))
+        {}
+    };
+
+    class ScriptCommandParser
+        : public SpecialCommandParser
+    {
+        std::vector<std::string> args;
+    public:
+        ScriptCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (this->args.empty()) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for 'script' command\r\n"));
+            }
+            std::string subcmd(this->args[0]);
+            std::transform(subcmd.begin(), subcmd.end(), subcmd.begin(), ::toupper);
+            if (subcmd == "LOAD" && this->args.size() == 2) {
+                return util::mkptr(new ScriptLoadGroup(c, std::move(this->args[1])));
+            }
+            if (subcmd == "FLUSH" && this->args.size() <= 2) {
+                script_flush();
+                return util::mkptr(new ScatterCommandGroup(
+                    c, msg::format_command("SCRIPT", this->args), REDUCE_ALL_OK));
+            }
+            return util::mkptr(new DirectCommandGroup(
+                c, "-ERR Unknown SCRIPT subcommand or wrong number of arguments\r\n"));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    /* MULTI, the queued commands and EXEC in one batch to the node of the slot */
+    class TransactionCommand
+        : public OneSlotCommand
+    {
+        msize_t const _queued;
+
+        static Buffer batch(util::sref<Transaction> t)
+        {
+            Buffer b(MULTI_CMD);
+            b.append_from(t->commands.begin(), t->commands.end());
+            Buffer exec(EXEC_CMD);
+            b.append_from(exec.begin(), exec.end());
+            return std::move(b);
+        }
+    public:
+        TransactionCommand(util::sref<Transaction> t, util::sref<CommandGroup> g)
+            : OneSlotCommand(batch(t), g, t->key_slot)
+            , _queued(t->count)
+        {}
+
+        msize_t leading_replies() const
+        {
+            return this->_queued + 1;
+        }
+    };
+
+    class MultiCommandParser
+        : public SpecialCommandParser
+    {
+    public:
+        MultiCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (c->transaction.not_nul()) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR MULTI calls can not be nested\r\n"));
+            }
+            c->transaction.reset(new Transaction);
+            return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+        }
+
+        void on_str(Buffer::iterator, Buffer::iterator) {}
+    };
+
+    class ExecCommandParser
+        : public SpecialCommandParser
+    {
+    public:
+        ExecCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (c->transaction.nul()) {
+                return util::mkptr(new DirectCommandGroup(c, "-ERR EXEC without MULTI\r\n"));
+            }
+            util::sptr<Transaction> t(std::move(c->transaction));
+            c->transaction.reset();
+            if (t->aborted) {
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-EXECABORT Transaction discarded because of previous errors.\r\n"));
+            }
+            if (t->count == 0) {
+                return util::mkptr(new DirectCommandGroup(c, "*0\r\n"));
+            }
+            util::sptr<SingleCommandGroup> g(new SingleCommandGroup(c));
+            g->command = util::mkptr(new TransactionCommand(*t, *g));
+            return std::move(g);
+        }
+
+        void on_str(Buffer::iterator, Buffer::iterator) {}
+    };
+
+    class DiscardCommandParser
+        : public SpecialCommandParser
+    {
+    public:
+        DiscardCommandParser() = default;
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator)
+        {
+            if (c->transaction.nul()) {
+                return util::mkptr(new DirectCommandGroup(c, "-ERR DISCARD without MULTI\r\n"));
+            }
+            c->transaction.reset();
+            return util::mkptr(new DirectCommandGroup(c, RSP_OK_STR));
+        }
+
+        void on_str(Buffer::iterator, Buffer::iterator) {}
+    };
+
+    slot key_slot_of(std::string const& key)
+    {
+        KeySlotCalc calc;
+        for (char b: key) {
+            calc.next_byte(b);
+        }
+        return calc.get_slot();
+    }
+
+    /* elements of an array reply of bulk strings, nil ones skipped */
+    bool parse_bulk_array_reply(Buffer& rsp, std::vector<std::string>& elements)
+    {
+        msize_t count;
+        Buffer::iterator i;
+        if (!::parse_array_reply(rsp, count, i)) {
+            return false;
+        }
+        try {
+            for (msize_t n = 0; n < count; ++n) {
+                if (i == rsp.end() || *i != '$') {
+                    return false;
+                }
+                auto r = msg::btoi(i + 1, rsp.end());
+                if (r.first < 0) {
+                    i = r.second;
+                    continue;
+                }
+                i = msg::parse_str(r.first, r.second, rsp.end());
+                elements.push_back(std::string(r.second, i - msg::LENGTH_OF_CR_LF));
+            }
+            return true;
+        } catch (msg::MessageInterrupted&) {
+            return false;
+        }
+    }
+
+    msize_t const STORE_BATCH_VALUES = 1024;
+
+    /*
+     * MULTI, DEL of the key and the command adding values to it in batches,
+     * then EXEC; count is set to the number of commands between MULTI and EXEC
+     */
+    std::string replace_key_batch(std::string const& key, std::string const& command,
+                                  std::vector<std::string> const& values, msize_t& count)
+    {
+        std::vector<std::string> args(1, key);
+        std::string batch(MULTI_CMD + msg::format_command("DEL", args));
+        count = 1;
+        for (std::string const& v: values) {
+            args.push_back(v);
+            if (args.size() == STORE_BATCH_VALUES + 1) {
+                batch += msg::format_command(command, args);
+                args.resize(1);
+                ++count;
+            }
+        }
+        if (args.size() > 1) {
+            batch += msg::format_command(command, args);
+            ++count;
+        }
+        return batch + EXEC_CMD;
+    }
+
+    enum SetOperation {
+        SET_INTER,
+        SET_UNION,
+        SET_DIFF,
+    };
+
+    /*
+     * SINTER, SUNION, SDIFF or their STORE variants of keys in several
+     * slots: fetch SMEMBERS of all keys at the same time and combine them
+     * in the proxy, then reply the result, or replace the destination
+     * with it by DEL and SADDs in a transaction
+     */
+    class SetOperationGroup
+        : public NodesCommandGroup
+    {
+        SetOperation const op;
+        std::vector<std::string> const keys;
+        bool const store;
+        std::string const destination;
+        msize_t fetched_bytes;
+        bool storing;
+        msize_t stored_count;
+
+        void on_nodes(bool reactivate)
+        {
+            for (msize_t i = 0; i < this->keys.size(); ++i) {
+                this->send(i, ::key_slot_of(this->keys[i]), msg::format_command(
+                    "SMEMBERS", std::vector<std::string>(1, this->keys[i])), reactivate);
+            }
+        }
+
+        void node_responsed(util::sref<NodeCommand> c)
+        {
+            Buffer& rsp = *c->buffer;
+            if (::is_error_reply(rsp)) {
+                return this->finish(std::move(rsp));
+            }
+            if (this->storing) {
+                if (*rsp.begin() != '*') {
+                    return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                }
+                return this->finish(Buffer(fmt::format(":{}\r\n", this->stored_count)));
+            }
+            this->fetched_bytes += rsp.size();
+            if (this->fetched_bytes > cerb_global::scatter_max_bytes) {
+                return this->finish(Buffer("-ERR sets exceed scatter-max-bytes\r\n"));
+            }
+            if (this->op == SET_INTER && !this->store && rsp.same_as_string("*0\r\n")) {
+                return this->finish(std::move(rsp));
+            }
+            if (this->awaiting != 0) {
+                return;
+            }
+            std::unordered_set<std::string> result;
+            for (msize_t i = 0; i < this->keys.size(); ++i) {
+                std::vector<std::string> members;
+                if (!::parse_bulk_array_reply(*this->node_commands[i]->buffer, members)) {
+                    return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                }
+                this->node_commands[i]->buffer->swap(Buffer());
+                if (i == 0 || this->op == SET_UNION) {
+                    result.insert(members.begin(), members.end());
+                } else if (this->op == SET_DIFF) {
+                    for (std::string const& m: members) {
+                        result.erase(m);
+                    }
+                } else {
+                    std::unordered_set<std::string> common;
+                    for (std::string& m: members) {
+                        if (result.find(m) != result.end()) {
+                            common.insert(std::move(m));
+                        }
+                    }
+                    result.swap(common);
+                }
+            }
+            if (this->store) {
+                return this->store_result(result);
+            }
+            std::string r(fmt::format("*{}\r\n", result.size()));
+            for (std::string const& m: result) {
+                r += ::bulk_string(m);
+            }
+            this->finish(Buffer(r));
+        }
+
+        void store_result(std::unordered_set<std::string> const& members)
+        {
+            msize_t commands;
+            std::string batch(::replace_key_batch(
+                this->destination, "SADD", std::vector<std::string>(
+                    members.begin(), members.end()), commands));
+            this->storing = true;
+            this->stored_count = members.size();
+            this->send(0, ::key_slot_of(this->destination), batch, true, commands + 1);
+        }
+    public:
+        SetOperationGroup(util::sref<Client> c, SetOperation op,
+                          std::vector<std::string> keys, bool store, std::string dest)
+            : NodesCommandGroup(c)
+            , op(op)
+            , keys(std::move(keys))
+            , store(store)
+            , destination(std::move(dest))
+            , fetched_bytes(0)
+            , storing(false)
+            , stored_count(0)
+        {}
+    };
+
+    class SetOperationCommandParser
+        : public SpecialCommandParser
+    {
+        std::string const command_name;
+        SetOperation const op;
+        bool const store;
+        Buffer::iterator const command_begin;
+        std::vector<std::string> args;
+    public:
+        SetOperationCommandParser(std::string name, SetOperation op, bool store,
+                                  Buffer::iterator command_begin)
+            : command_name(std::move(name))
+            , op(op)
+            , store(store)
+            , command_begin(command_begin)
+        {}
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->args.size() < (this->store ? 2 : 1)) {
+                std::string name(this->command_name);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                return util::mkptr(new DirectCommandGroup(
+                    c, "-ERR wrong number of arguments for '" + name + "' command\r\n"));
+            }
+            slot s = ::key_slot_of(this->args[0]);
+            if (std::all_of(this->args.begin() + 1, this->args.end(),
+                            [&](std::string const& k) { return ::key_slot_of(k) == s; }))
+            {
+                return util::mkptr(new SingleCommandGroup(c, Buffer(this->command_begin, end), s));
+            }
+            std::string dest;
+            if (this->store) {
+                dest = std::move(this->args[0]);
+                this->args.erase(this->args.begin());
+            }
+            return util::mkptr(new SetOperationGroup(
+                c, this->op, std::move(this->args), this->store, std::move(dest)));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    enum ScoreAggregate {
+        AGGREGATE_SUM,
+        AGGREGATE_MIN,
+        AGGREGATE_MAX,
+    };
+
+    bool parse_score(std::string const& s, double& score)
+    {
+        if (s.empty()) {
+            return false;
+        }
+        char* end;
+        score = std::strtod(s.c_str(), &end);
+        return *end == '\0' && !std::isnan(score);
+    }
+
+    msize_t const FETCH_PAGE_MEMBERS = 1024;
+
+    /*
+     * ZUNIONSTORE or ZINTERSTORE of keys in several slots: fetch members
+     * with scores of all keys at the same time, each by pages of ZRANGE,
+     * aggregate them in the proxy, then replace the destination with the
+     * result by DEL and ZADDs in a transaction
+     */
+    class SortedSetStoreGroup
+        : public NodesCommandGroup
+    {
+        bool const inter;
+        std::string const destination;
+        std::vector<std::string> const keys;
+        std::vector<double> const weights;
+        ScoreAggregate const aggregate;
+        /* weighted members of each key and the index of its next page */
+        std::vector<std::unordered_map<std::string, double>> operands;
+        std::vector<msize_t> next_index;
+        msize_t fetched_bytes;
+        bool storing;
+        msize_t stored_count;
+
+        void fetch_page(msize_t i, bool reactivate)
+        {
+            this->send(i, ::key_slot_of(this->keys[i]), msg::format_command(
+                "ZRANGE", std::vector<std::string>({
+                    this->keys[i], fmt::format("{}", this->next_index[i]),
+                    fmt::format("{}", this->next_index[i] + FETCH_PAGE_MEMBERS - 1),
+                    "WITHSCORES"})), reactivate);
+        }
+
+        void on_nodes(bool reactivate)
+        {
+            this->operands.assign(this->keys.size(), std::unordered_map<std::string, double>());
+            this->next_index.assign(this->keys.size(), 0);
+            this->fetched_bytes = 0;
+            for (msize_t i = 0; i < this->keys.size(); ++i) {
+                this->fetch_page(i, reactivate);
+            }
+        }
+
+        double combine(double a, double b) const
+        {
+            switch (this->aggregate) {
+            case AGGREGATE_MIN:
+                return std::min(a, b);
+            case AGGREGATE_MAX:
+                return std::max(a, b);
+            default:
+                {
+                    double sum = a + b;
+                    /* like redis, inf plus -inf is 0 */
+                    return std::isnan(sum) ? 0 : sum;
+                }
+            }
+        }
+
+        void node_responsed(util::sref<NodeCommand> c)
+        {
+            Buffer& rsp = *c->buffer;
+            if (::is_error_reply(rsp)) {
+                return this->finish(std::move(rsp));
+            }
+            if (this->storing) {
+                if (*rsp.begin() != '*') {
+                    return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                }
+                return this->finish(Buffer(fmt::format(":{}\r\n", this->stored_count)));
+            }
+            this->fetched_bytes += rsp.size();
+            if (this->fetched_bytes > cerb_global::scatter_max_bytes) {
+                return this->finish(Buffer("-ERR sorted sets exceed scatter-max-bytes\r\n"));
+            }
+            msize_t i = std::find_if(
+                this->node_commands.begin(), this->node_commands.end(),
+                [&](util::sptr<NodeCommand> const& n) { return n.id() == c.id(); })
+                - this->node_commands.begin();
+            std::vector<std::string> elements;
+            if (!::parse_bulk_array_reply(rsp, elements) || elements.size() % 2 != 0) {
+                return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+            }
+            rsp.swap(Buffer());
+            for (msize_t e = 0; e < elements.size(); e += 2) {
+                double score;
+                if (!::parse_score(elements[e + 1], score)) {
+                    return this->finish(Buffer("-ERR unexpected reply from node\r\n"));
+                }
+                score *= this->weights[i];
+                if (std::isnan(score)) {
+                    score = 0;
+                }
+                /* a member moved between pages by a concurrent write is kept once */
+                this->operands[i][std::move(elements[e])] = score;
+            }
+            if (elements.size() / 2 == FETCH_PAGE_MEMBERS) {
+                this->next_index[i] += FETCH_PAGE_MEMBERS;
+                return this->fetch_page(i, true);
+            }
+            if (this->awaiting != 0) {
+                return;
+            }
+            std::unordered_map<std::string, double> result(std::move(this->operands[0]));
+            for (msize_t k = 1; k < this->keys.size(); ++k) {
+                std::unordered_map<std::string, double> next;
+                for (auto& m: this->operands[k]) {
+                    auto r = result.find(m.first);
+                    if (r != result.end()) {
+                        r->second = this->combine(r->second, m.second);
+                        if (this->inter) {
+                            next.insert(*r);
+                        }
+                    } else if (!this->inter) {
+                        result.insert(std::move(m));
+                    }
+                }
+                this->operands[k].clear();
+                if (this->inter) {
+                    result.swap(next);
+                }
+            }
+            std::vector<std::string> values;
+            values.reserve(result.size() * 2);
+            for (auto const& m: result) {
+                values.push_back(fmt::format("{:.17g}", m.second));
+                values.push_back(m.first);
+            }
+            msize_t commands;
+            std::string batch(::replace_key_batch(this->destination, "ZADD", values, commands));
+            this->storing = true;
+            this->stored_count = result.size();
+            this->send(0, ::key_slot_of(this->destination), batch, true, commands + 1);
+        }
+    public:
+        SortedSetStoreGroup(util::sref<Client> c, bool inter, std::string dest,
+                            std::vector<std::string> keys, std::vector<double> weights,
+                            ScoreAggregate aggregate)
+            : NodesCommandGroup(c)
+            , inter(inter)
+            , destination(std::move(dest))
+            , keys(std::move(keys))
+            , weights(std::move(weights))
+            , aggregate(aggregate)
+            , fetched_bytes(0)
+            , storing(false)
+            , stored_count(0)
+        {}
+    };
+
+    class SortedSetStoreCommandParser
+        : public SpecialCommandParser
+    {
+        bool const inter;
+        Buffer::iterator const command_begin;
+        std::vector<std::string> args;
+
+        util::sptr<CommandGroup> error(util::sref<Client> c, std::string const& msg)
+        {
+            return util::mkptr(new DirectCommandGroup(c, "-ERR " + msg + "\r\n"));
+        }
+    public:
+        SortedSetStoreCommandParser(bool inter, Buffer::iterator command_begin)
+            : inter(inter)
+            , command_begin(command_begin)
+        {}
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->args.size() < 3) {
+                return this->error(c, fmt::format(
+                    "wrong number of arguments for '{}' command",
+                    this->inter ? "zinterstore" : "zunionstore"));
+            }
+            int numkeys;
+            try {
+                numkeys = util::atoi(this->args[1]);
+            } catch (BadRedisMessage&) {
+                return this->error(c, "value is not an integer or out of range");
+            }
+            if (numkeys < 1) {
+                return this->error(c, "at least 1 input key is needed for "
+                                      "ZUNIONSTORE/ZINTERSTORE");
+            }
+            if (this->args.size() < msize_t(numkeys) + 2) {
+                return this->error(c, "syntax error");
+            }
+            std::vector<std::string> keys(this->args.begin() + 2,
+                                          this->args.begin() + 2 + numkeys);
+            std::vector<double> weights(numkeys, 1);
+            ScoreAggregate aggregate = AGGREGATE_SUM;
+            for (msize_t i = numkeys + 2; i < this->args.size(); ++i) {
+                std::string opt(this->args[i]);
+                std::transform(opt.begin(), opt.end(), opt.begin(), ::toupper);
+                if (opt == "WEIGHTS" && i + numkeys < this->args.size()) {
+                    for (int k = 0; k < numkeys; ++k) {
+                        if (!::parse_score(this->args[++i], weights[k])) {
+                            return this->error(c, "weight value is not a float");
+                        }
+                    }
+                } else if (opt == "AGGREGATE" && i + 1 < this->args.size()) {
+                    std::string a(this->args[++i]);
+                    std::transform(a.begin(), a.end(), a.begin(), ::toupper);
+                    if (a == "SUM") {
+                        aggregate = AGGREGATE_SUM;
+                    } else if (a == "MIN") {
+                        aggregate = AGGREGATE_MIN;
+                    } else if (a == "MAX") {
+                        aggregate = AGGREGATE_MAX;
+                    } else {
+                        return this->error(c, "syntax error");
+                    }
+                } else {
+                    return this->error(c, "syntax error");
+                }
+            }
+            slot s = ::key_slot_of(this->args[0]);
+            if (std::all_of(keys.begin(), keys.end(),
+                            [&](std::string const& k) { return ::key_slot_of(k) == s; }))
+            {
+                return util::mkptr(new SingleCommandGroup(c, Buffer(this->command_begin, end), s));
+            }
+            return util::mkptr(new SortedSetStoreGroup(
+                c, this->inter, std::move(this->args[0]), std::move(keys),
+                std::move(weights), aggregate));
+        }
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+    };
+
+    std::string const PING_CMD(msg::format_command("PING", std::vector<std::string>()));
+
+    /*
+     * Commands of a client in bulk mode from one read. They are sliced by
+     * node and each slice is sent as one command, followed by a PING which
+     * marks its end; replies to the commands are counted, not forwarded
+     */
+    class BulkGroup
+        : public NodesCommandGroup
+    {
+        struct Entry {
+            slot key_slot;
+            msize_t begin;
+            msize_t end;
+        };
+
+        std::shared_ptr<BulkIngest> const bulk;
+        Buffer commands;
+        std::vector<Entry> entries;
+
+        void on_nodes(bool reactivate)
+        {
+            Proxy* proxy = this->client->proxy();
+            std::map<Server*, msize_t> slice_index;
+            std::vector<slot> slice_slots;
+            std::vector<std::string> slices;
+            std::vector<msize_t> slice_sizes;
+            for (Entry const& e: this->entries) {
+                Server* svr = proxy->get_server_by_slot(e.key_slot);
+                if (svr == nullptr) {
+                    this->bulk->error("CLUSTERDOWN Hash slot not served");
+                    continue;
+                }
+                auto r = slice_index.insert(std::make_pair(svr, slices.size()));
+                if (r.second) {
+                    slice_slots.push_back(e.key_slot);
+                    slices.push_back(std::string());
+                    slice_sizes.push_back(0);
+                }
+                msize_t i = r.first->second;
+                slices[i].append(this->commands.begin() + e.begin,
+                                 this->commands.begin() + e.end);
+                ++slice_sizes[i];
+            }
+            this->commands.swap(Buffer());
+            this->entries.clear();
+            if (slices.empty()) {
+                return this->finish(Buffer());
+            }
+            for (msize_t i = 0; i < slices.size(); ++i) {
+                this->send(i, slice_slots[i], slices[i] + PING_CMD, reactivate, slice_sizes[i]);
+            }
+        }
+
+        void node_leading_reply(Buffer const& rsp, bool moved)
+        {
+            if (moved) {
+                return this->bulk->error("MOVED, ASK or CLUSTERDOWN, not retried");
+            }
+            if (rsp.size() != 0 && *rsp.cbegin() == '-') {
+                return this->bulk->error(std::string(rsp.cbegin() + 1,
+                                                     rsp.cend() - msg::LENGTH_OF_CR_LF));
+            }
+            ++this->bulk->ok;
+        }
+
+        void node_responsed(util::sref<NodeCommand>)
+        {
+            if (this->awaiting == 0) {
+                this->finish(Buffer());
+            }
+        }
+    public:
+        BulkGroup(util::sref<Client> c, std::shared_ptr<BulkIngest> b)
+            : NodesCommandGroup(c)
+            , bulk(std::move(b))
+        {}
+
+        void add(slot key_slot, Buffer::iterator begin, Buffer::iterator end)
+        {
+            msize_t offset = this->commands.size();
+            this->commands.append_from(begin, end);
+            this->entries.push_back(Entry{key_slot, offset, this->commands.size()});
+        }
+    };
+
+    /* strict like redis: no spaces or plus sign, within 64 bits */
+    bool parse_int64(std::string const& s, int64_t& value)
+    {
+        if (s.empty() || s.size() > 20 || !(std::isdigit(s[0]) || s[0] == '-')) {
+            return false;
+        }
+        char* end;
+        errno = 0;
+        value = std::strtoll(s.c_str(), &end, 10);
+        return errno == 0 && end == s.c_str() + s.size();
+    }
+
+    std::string wrong_args_error(std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return fmt::format("-ERR wrong number of arguments for '{}' command\r\n", name);
+    }
+
+    /*
+     * INCR, INCRBY, DECR, DECRBY and HINCRBY, coalesced if the key is under
+     * coalesce-prefixes and forwarded as they are otherwise
+     */
+    class IncrementCommandParser
+        : public SpecialCommandParser
+    {
+        std::string const name;
+        bool const hash;
+        msize_t const argc;
+        int64_t const sign;
+        Buffer::iterator const command_begin;
+        std::vector<std::string> args;
+    public:
+        IncrementCommandParser(std::string n, bool h, msize_t c, int64_t s, Buffer::iterator b)
+            : name(std::move(n))
+            , hash(h)
+            , argc(c)
+            , sign(s)
+            , command_begin(b)
+        {}
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->args.size() != this->argc) {
+                return util::mkptr(new DirectCommandGroup(c, ::wrong_args_error(this->name)));
+            }
+            int64_t delta = this->sign;
+            bool coalesce = coalesce_key(this->args[0]);
+            if (coalesce && this->argc > (this->hash ? 2 : 1)) {
+                coalesce = ::parse_int64(this->args.back(), delta)
+                        && !(this->sign < 0 && delta == INT64_MIN);
+                delta *= this->sign;
+            }
+            if (!coalesce) {
+                return util::mkptr(new SingleCommandGroup(
+                    c, Buffer(this->command_begin, end), ::key_slot_of(this->args[0])));
+            }
+            return coalesce_increment(c, this->hash, std::move(this->args[0]),
+                                      this->hash ? std::move(this->args[1]) : "", delta);
+        }
+    };
+
+    /*
+     * SET, SETNX, SETEX, PSETEX, HSET, HSETNX and HMSET with values
+     * compressed if the key is under compress-prefixes; the value is the
+     * argument at value_index, and so is every other argument after it
+     * for those taking field value pairs
+     */
+    class CompressCommandParser
+        : public SpecialCommandParser
+    {
+        std::string const name;
+        msize_t const value_index;
+        bool const pairs;
+        Buffer::iterator const command_begin;
+        std::vector<std::pair<Buffer::iterator, Buffer::iterator>> args;
+    public:
+        CompressCommandParser(std::string n, msize_t v, bool p, Buffer::iterator b)
+            : name(std::move(n))
+            , value_index(v)
+            , pairs(p)
+            , command_begin(b)
+        {}
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::make_pair(begin, end));
+        }
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->args.size() <= this->value_index) {
+                return util::mkptr(new DirectCommandGroup(c, ::wrong_args_error(this->name)));
+            }
+            std::string key(this->args[0].first, this->args[0].second);
+            slot s = ::key_slot_of(key);
+            if (!compress_key(key)) {
+                return util::mkptr(new SingleCommandGroup(c, Buffer(this->command_begin, end), s));
+            }
+            std::vector<std::string> argv;
+            bool compressed = false;
+            for (msize_t i = 0; i < this->args.size(); ++i) {
+                std::string value;
+                bool is_value = i == this->value_index || (
+                    this->pairs && i > this->value_index && (i - this->value_index) % 2 == 0);
+                if (is_value && ::compress_arg(this->args[i].first, this->args[i].second, value)) {
+                    compressed = true;
+                } else {
+                    value.assign(this->args[i].first, this->args[i].second);
+                }
+                argv.push_back(std::move(value));
+            }
+            if (!compressed) {
+                return util::mkptr(new SingleCommandGroup(c, Buffer(this->command_begin, end), s));
+            }
+            return util::mkptr(new SingleCommandGroup(
+                c, Buffer(msg::format_command(this->name, argv)), s));
+        }
+    };
+
+    /* GET and HGET of keys under compress-prefixes */
+    class DecompressCommandParser
+        : public SpecialCommandParser
+    {
+        std::string const name;
+        msize_t const argc;
+        Buffer::iterator const command_begin;
+        std::vector<std::string> args;
+    public:
+        DecompressCommandParser(std::string n, msize_t c, Buffer::iterator b)
+            : name(std::move(n))
+            , argc(c)
+            , command_begin(b)
+        {}
+
+        void on_str(Buffer::iterator begin, Buffer::iterator end)
+        {
+            this->args.push_back(std::string(begin, end));
+        }
+
+        util::sptr<CommandGroup> spawn_commands(util::sref<Client> c, Buffer::iterator end)
+        {
+            if (this->args.size() != this->argc) {
+                return util::mkptr(new DirectCommandGroup(c, ::wrong_args_error(this->name)));
+            }
+            slot s = ::key_slot_of(this->args[0]);
+            if (!compress_key(this->args[0])) {
+                return util::mkptr(new SingleCommandGroup(c, Buffer(this->command_begin, end), s));
+            }
+            util::sptr<SingleCommandGroup> g(new SingleCommandGroup(c));
+            g->command.reset(new DecompressCommand(Buffer(this->command_begin, end), *g, s));
+            return std::move(g);
+        }
+    };
+
+    using CmdPtr = util::sptr<SpecialCommandParser>;
+    using CmdCreateFn = CmdPtr(*)(Buffer::iterator, Buffer::iterator);
+    std::map<std::string, CmdCreateFn> SPECIAL_RSP(
+    {
+        {"PING",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new PingCommandParser);
+            }},
+        {"INFO",
             [](Buffer::iterator, Buffer::iterator) -> CmdPtr
             {
                 return util::mkptr(new ProxyStatsCommandParser);
@@ -928,7 +3014,17 @@ namespace {
         {"PROXY",
             [](Buffer::iterator, Buffer::iterator) -> CmdPtr
             {
-                return util::mkptr(new ProxyStatsCommandParser);
+                return util::mkptr(new ProxyCommandParser);
+            }},
+        {"MONITOR",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new MonitorCommandParser);
+            }},
+        {"CLIENT",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ClientCommandParser);
             }},
         {"UPDATESLOTMAP",
             [](Buffer::iterator, Buffer::iterator) -> CmdPtr
@@ -940,11 +3036,70 @@ namespace {
             {
                 return util::mkptr(new SetRemotesCommandParser);
             }},
+        {"SLOWLOG",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SlowLogCommandParser);
+            }},
         {"MGET",
             [](Buffer::iterator, Buffer::iterator arg_start) -> CmdPtr
             {
                 return util::mkptr(new MGetCommandParser(arg_start));
             }},
+        {"SCAN",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScanCommandParser);
+            }},
+        {"KEYS",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScatterCommandParser("KEYS", REDUCE_CONCAT, 1, 1));
+            }},
+        {"DBSIZE",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScatterCommandParser("DBSIZE", REDUCE_SUM, 0, 0));
+            }},
+        {"RANDOMKEY",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScatterCommandParser(
+                    "RANDOMKEY", REDUCE_FIRST_NON_NIL, 0, 0));
+            }},
+        {"MULTI",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new MultiCommandParser);
+            }},
+        {"EXEC",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ExecCommandParser);
+            }},
+        {"DISCARD",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new DiscardCommandParser);
+            }},
+        {"SINTER",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SINTER", SET_INTER, false, command_begin));
+            }},
+        {"SUNION",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SUNION", SET_UNION, false, command_begin));
+            }},
+        {"SDIFF",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SDIFF", SET_DIFF, false, command_begin));
+            }},
         {"SUBSCRIBE",
             [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
             {
@@ -969,6 +3124,29 @@ namespace {
         "ZREVRANGE", "ZREVRANGEBYSCORE", "ZREVRANK", "ZSCORE",
     });
 
+    /*
+     * Multiple keys commands that could be queued in a transaction, where
+     * the first key decides the slot and the node rejects other keys that
+     * are not in the slot
+     */
+    std::set<std::string> TRANSACTION_MULTI_KEY_COMMANDS({"MGET"});
+
+    /*
+     * Single key writes acknowledged at once for clients in no-reply mode,
+     * filled if writing is allowed
+     */
+    std::set<std::string> NOREPLY_COMMANDS;
+
+    /* commands handled by the proxy even in a transaction */
+    std::set<std::string> const TRANSACTION_CONTROL_COMMANDS({"MULTI", "EXEC", "DISCARD"});
+
+    /* commands answered by the proxy itself, never shed on overload */
+    std::set<std::string> const SHED_EXEMPT_COMMANDS({
+        "PING", "INFO", "PROXY", "MONITOR", "CLIENT", "UPDATESLOTMAP",
+        "SETREMOTES", "SLOWLOG", "MULTI", "EXEC", "DISCARD",
+        "SUBSCRIBE", "PSUBSCRIBE",
+    });
+
     class ClientCommandSplitter
         : public cerb::msg::MessageSplitterBase<
             Buffer::iterator, ClientCommandSplitter>
@@ -999,10 +3177,15 @@ namespace {
         }
     public:
         Iterator last_command_begin;
+        std::string last_command_name;
         KeySlotCalc slot_calc;
         bool last_command_is_bad;
         util::sptr<SpecialCommandParser> special_parser;
         util::sref<Client> client;
+        util::sptr<BulkGroup> bulk_group;
+        bool last_command_noreply;
+        /* a former command of the client is yet to be replied by nodes */
+        bool remote_pending;
 
         void on_string(Iterator begin, Iterator end)
         {
@@ -1016,16 +3199,23 @@ namespace {
             , last_command_is_bad(false)
             , special_parser(nullptr)
             , client(cli)
+            , bulk_group(nullptr)
+            , last_command_noreply(false)
+            , remote_pending(cli->remote_pending())
         {}
 
         ClientCommandSplitter(ClientCommandSplitter&& rhs)
             : BaseType(std::move(rhs))
             , _on_str(rhs._on_str)
             , last_command_begin(rhs.last_command_begin)
+            , last_command_name(std::move(rhs.last_command_name))
             , slot_calc(std::move(rhs.slot_calc))
             , last_command_is_bad(rhs.last_command_is_bad)
             , special_parser(std::move(rhs.special_parser))
             , client(rhs.client)
+            , bulk_group(std::move(rhs.bulk_group))
+            , last_command_noreply(rhs.last_command_noreply)
+            , remote_pending(rhs.remote_pending)
         {}
 
         bool handle_standard_key_command(std::string const& command)
@@ -1039,10 +3229,105 @@ namespace {
             return true;
         }
 
+        /* commands with a key as the first argument, the one shown by slot_calc */
+        void select_first_key_command_parser(std::string const& cmd)
+        {
+            if (this->handle_standard_key_command(cmd)) {
+                return;
+            }
+            if (TRANSACTION_MULTI_KEY_COMMANDS.find(cmd) != TRANSACTION_MULTI_KEY_COMMANDS.end()) {
+                this->last_command_is_bad = true;
+                this->_on_str = ClientCommandSplitter::on_command_key;
+                return;
+            }
+            this->last_command_is_bad = true;
+            this->_on_str = ClientCommandSplitter::on_string_nop;
+        }
+
+        void add_bulk_command(Iterator i)
+        {
+            if (this->last_command_is_bad) {
+                return this->client->bulk->error(fmt::format(
+                    "ERR Command {} not allowed in bulk mode"
+                    " or command key not specified", this->last_command_name));
+            }
+            if (this->bulk_group.nul()) {
+                this->bulk_group.reset(new BulkGroup(this->client, this->client->bulk));
+            }
+            CERB_PROBE2(command__parsed, this->last_command_name.c_str(),
+                        int(this->slot_calc.get_slot()));
+            this->bulk_group->add(this->slot_calc.get_slot(), this->last_command_begin, i);
+        }
+
+        /* push commands of bulk mode before any other command */
+        void flush_bulk()
+        {
+            if (this->bulk_group.not_nul()) {
+                this->push_group(std::move(this->bulk_group));
+                this->bulk_group.reset();
+            }
+        }
+
+        void push_group(util::sptr<CommandGroup> g)
+        {
+            if (g->wait_remote()) {
+                this->remote_pending = true;
+            }
+            this->client->push_command(std::move(g));
+        }
+
+        util::sptr<CommandGroup> queue_transaction_command(Iterator i)
+        {
+            util::sref<Transaction> t(*this->client->transaction);
+            if (this->last_command_is_bad) {
+                t->aborted = true;
+                return util::mkptr(new DirectCommandGroup(client, fmt::format(
+                    "-ERR Command {} not allowed in a transaction"
+                    " or command key not specified\r\n", this->last_command_name)));
+            }
+            slot s = this->slot_calc.get_slot();
+            if (t->count != 0 && s != t->key_slot) {
+                t->aborted = true;
+                return util::mkptr(new DirectCommandGroup(
+                    client, "-CROSSSLOT Keys in request don't hash to the same slot\r\n"));
+            }
+            t->key_slot = s;
+            t->commands.append_from(this->last_command_begin, i);
+            ++t->count;
+            return util::mkptr(new DirectCommandGroup(client, "+QUEUED\r\n"));
+        }
+
+        /* returns false if the node is unknown yet */
+        bool send_noreply_command(Iterator i)
+        {
+            Proxy* proxy = this->client->proxy();
+            Server* svr = proxy->get_server_by_slot(this->slot_calc.get_slot());
+            if (svr == nullptr) {
+                return false;
+            }
+            NoReplyServer* s = NoReplyServer::get_server(svr->addr, proxy);
+            if (s == nullptr) {
+                return false;
+            }
+            return s->push_command(Buffer(this->last_command_begin, i));
+        }
+
         void select_command_parser(Iterator begin, Iterator end)
         {
             std::string cmd;
             std::for_each(begin, end, [&](byte b) { cmd += std::toupper(b); });
+            this->last_command_name = cmd;
+            if (this->client->bulk && cmd != "PROXY") {
+                return this->select_first_key_command_parser(cmd);
+            }
+            if (this->client->transaction.not_nul() &&
+                TRANSACTION_CONTROL_COMMANDS.find(cmd) == TRANSACTION_CONTROL_COMMANDS.end())
+            {
+                return this->select_first_key_command_parser(cmd);
+            }
+            if (this->client->noreply && NOREPLY_COMMANDS.find(cmd) != NOREPLY_COMMANDS.end()) {
+                this->last_command_noreply = true;
+            }
             if (this->handle_standard_key_command(cmd)) {
                 return;
             }
@@ -1056,32 +3341,75 @@ namespace {
             this->_on_str = ClientCommandSplitter::on_string_nop;
         }
 
+        util::sptr<CommandGroup> spawn_group(Iterator i)
+        {
+            if (this->special_parser.nul() && this->client->transaction.not_nul()) {
+                CERB_PROBE2(command__parsed, this->last_command_name.c_str(), -1);
+                return this->queue_transaction_command(i);
+            }
+            if (this->last_command_is_bad) {
+                return util::mkptr(new DirectCommandGroup(
+                    client, "-ERR Unknown command or command key not specified\r\n"));
+            }
+            if (SHED_EXEMPT_COMMANDS.find(this->last_command_name) == SHED_EXEMPT_COMMANDS.end() &&
+                !this->client->proxy()->shedder.admit(this->last_command_name))
+            {
+                this->special_parser.reset();
+                return util::mkptr(new DirectCommandGroup(
+                    client, "-BUSY Proxy overloaded, try again later\r\n"));
+            }
+            if (this->special_parser.nul()) {
+                CERB_PROBE2(command__parsed, this->last_command_name.c_str(),
+                            int(this->slot_calc.get_slot()));
+                /*
+                 * a write sent on the no reply connection could overtake
+                 * former commands still to be sent or replied, so it is
+                 * sent as usual until they are replied
+                 */
+                if (this->last_command_noreply && !this->remote_pending &&
+                    this->send_noreply_command(i))
+                {
+                    return util::mkptr(new DirectCommandGroup(client, RSP_OK_STR));
+                }
+                return util::mkptr(new SingleCommandGroup(
+                    client, Buffer(this->last_command_begin, i), this->slot_calc.get_slot()));
+            }
+            CERB_PROBE2(command__parsed, this->last_command_name.c_str(), -1);
+            util::sptr<CommandGroup> g(this->special_parser->spawn_commands(this->client, i));
+            this->special_parser.reset();
+            return std::move(g);
+        }
+
         void on_split_point(Iterator i)
         {
             this->_on_str = ClientCommandSplitter::on_command_head;
-            if (this->last_command_is_bad) {
-                this->client->push_command(util::mkptr(new DirectCommandGroup(
-                    client, "-ERR Unknown command or command key not specified\r\n")));
-            } else if (this->special_parser.nul()) {
-                this->client->push_command(util::mkptr(new SingleCommandGroup(
-                    client, Buffer(this->last_command_begin, i), this->slot_calc.get_slot())));
+            monitor_feed(this->client, this->last_command_begin, i);
+            if (this->special_parser.nul() && this->client->bulk) {
+                this->add_bulk_command(i);
             } else {
-                this->client->push_command(this->special_parser->spawn_commands(this->client, i));
-                this->special_parser.reset();
+                this->flush_bulk();
+                util::sptr<CommandGroup> g(this->spawn_group(i));
+                if (Tracer::sample()) {
+                    g->trace.reset(new CommandTrace(
+                        this->last_command_name, this->client->last_read(), g->creation));
+                }
+                this->push_group(std::move(g));
             }
             this->last_command_begin = i;
             this->slot_calc.reset();
             this->last_command_is_bad = false;
+            this->last_command_noreply = false;
         }
 
         void on_array(cerb::rint size)
         {
             /*
-             * Redis server will reset a request of more than 1M args.
-             * See also
+             * Redis server will reset a request of more than 1M args, which
+             * is the default of max-request-args. See also
              * https://github.com/antirez/redis/blob/3.0/src/networking.c#L1001
              */
-            if (size > 1024 * 1024) {
+            if (size > cerb::rint(cerb_global::max_request_args)) {
+                cerb_global::thread_stats.add(STAT_REQUEST_ARGS_REJECTED, 1);
                 throw BadRedisMessage("Request is too large");
             }
             if (!this->_nested_array_element_count.empty()) {
@@ -1103,6 +3431,7 @@ void Command::on_remote_responsed(Buffer rsp, bool)
 
 void Command::responsed()
 {
+    this->group->command_replied(util::mkref(*this));
     this->group->command_responsed();
 }
 
@@ -1111,6 +3440,7 @@ void cerb::split_client_command(Buffer& buffer, util::sref<Client> cli)
     ClientCommandSplitter c(cerb::msg::split_by(
         buffer.begin(), buffer.end(), ClientCommandSplitter(
             buffer.begin(), cli)));
+    c.flush_bulk();
     if (c.finished()) {
         buffer.clear();
     } else {
@@ -1118,6 +3448,57 @@ void cerb::split_client_command(Buffer& buffer, util::sref<Client> cli)
     }
 }
 
+/* reads a complete bulk string at i and moves i after it */
+static bool read_bulk(Buffer::iterator& i, Buffer::iterator end, std::string& s)
+{
+    if (i == end || *i != '$') {
+        return false;
+    }
+    auto r = msg::btou(++i, end);
+    if (r.first < 0 || end - r.second < r.first + msg::LENGTH_OF_CR_LF) {
+        return false;
+    }
+    s.assign(r.second, r.second + r.first);
+    i = r.second + r.first + msg::LENGTH_OF_CR_LF;
+    return true;
+}
+
+util::sptr<CommandGroup> cerb::stream_client_command(
+    Buffer& buffer, util::sref<Client> cli, util::sref<DataCommand>& cmd)
+{
+    std::string name;
+    std::string key;
+    try {
+        Buffer::iterator i = buffer.begin();
+        if (i == buffer.end() || *i != '*') {
+            return util::sptr<CommandGroup>(nullptr);
+        }
+        auto r = msg::btou(++i, buffer.end());
+        i = r.second;
+        if (r.first < 2 || !::read_bulk(i, buffer.end(), name) ||
+            !::read_bulk(i, buffer.end(), key))
+        {
+            return util::sptr<CommandGroup>(nullptr);
+        }
+    } catch (msg::MessageInterrupted&) {
+        return util::sptr<CommandGroup>(nullptr);
+    }
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    if (STD_COMMANDS.find(name) == STD_COMMANDS.end() || (
+            cli->noreply && NOREPLY_COMMANDS.find(name) != NOREPLY_COMMANDS.end()))
+    {
+        return util::sptr<CommandGroup>(nullptr);
+    }
+    KeySlotCalc slot_calc;
+    std::for_each(key.begin(), key.end(), [&](byte b) { slot_calc.next_byte(b); });
+    CERB_PROBE2(command__parsed, name.c_str(), int(slot_calc.get_slot()));
+
+    util::sptr<SingleCommandGroup> g(new SingleCommandGroup(cli));
+    g->command.reset(new StreamedRequestCommand(*g, slot_calc.get_slot()));
+    cmd = *g->command;
+    return std::move(g);
+}
+
 void Command::allow_write_commands()
 {
     static std::set<std::string> const WRITE_COMMANDS({
@@ -1138,6 +3519,19 @@ void Command::allow_write_commands()
     for (std::string const& c: WRITE_COMMANDS) {
         STD_COMMANDS.insert(c);
     }
+    for (std::string const& c: {
+            "EXPIRE", "EXPIREAT", "PEXPIRE", "PEXPIREAT", "PERSIST",
+            "SET", "SETNX", "SETEX", "PSETEX", "SETBIT", "APPEND", "SETRANGE",
+            "INCR", "DECR", "INCRBY", "DECRBY", "INCRBYFLOAT",
+            "HSET", "HSETNX", "HDEL", "HINCRBY", "HINCRBYFLOAT", "HMSET",
+            "LPUSH", "LPUSHX", "RPUSH", "RPUSHX", "LREM", "LTRIM",
+            "SADD", "SREM", "ZADD", "ZREM", "ZINCRBY"})
+    {
+        NOREPLY_COMMANDS.insert(c);
+    }
+    for (std::string const& c: {"DEL", "MSET", "RENAME", "RENAMENX"}) {
+        TRANSACTION_MULTI_KEY_COMMANDS.insert(c);
+    }
     static std::map<std::string, CmdCreateFn> const SPECIAL_WRITE_COMMAND(
     {
         {"DEL",
@@ -1151,10 +3545,42 @@ void Command::allow_write_commands()
                 return util::mkptr(new MSetCommandParser(arg_start));
             }},
         {"RENAME",
-            [](Buffer::iterator command_begin, Buffer::iterator arg_start) -> CmdPtr
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new RenameCommandParser(command_begin, false));
+            }},
+        {"RENAMENX",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new RenameCommandParser(command_begin, true));
+            }},
+        {"SINTERSTORE",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SINTERSTORE", SET_INTER, true, command_begin));
+            }},
+        {"SUNIONSTORE",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SUNIONSTORE", SET_UNION, true, command_begin));
+            }},
+        {"SDIFFSTORE",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SetOperationCommandParser(
+                    "SDIFFSTORE", SET_DIFF, true, command_begin));
+            }},
+        {"ZUNIONSTORE",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new SortedSetStoreCommandParser(false, command_begin));
+            }},
+        {"ZINTERSTORE",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
             {
-                return util::mkptr(new RenameCommandParser(
-                    command_begin, arg_start));
+                return util::mkptr(new SortedSetStoreCommandParser(true, command_begin));
             }},
         {"PUBLISH",
             [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
@@ -1181,8 +3607,140 @@ void Command::allow_write_commands()
             {
                 return util::mkptr(new EvalCommandParser(command_begin));
             }},
+        {"EVALSHA",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new EvalShaCommandParser);
+            }},
+        {"SCRIPT",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScriptCommandParser);
+            }},
+        {"FLUSHALL",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScatterCommandParser("FLUSHALL", REDUCE_ALL_OK, 0, 1));
+            }},
+        {"FLUSHDB",
+            [](Buffer::iterator, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new ScatterCommandParser("FLUSHDB", REDUCE_ALL_OK, 0, 1));
+            }},
     });
     for (auto const& c: SPECIAL_WRITE_COMMAND) {
         SPECIAL_RSP.insert(c);
     }
 }
+
+void Command::coalesce_increments()
+{
+    if (STD_COMMANDS.find("INCR") == STD_COMMANDS.end()) {
+        return;
+    }
+    static std::map<std::string, CmdCreateFn> const INCREMENT_COMMANDS(
+    {
+        {"INCR",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new IncrementCommandParser(
+                    "INCR", false, 1, 1, command_begin));
+            }},
+        {"INCRBY",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new IncrementCommandParser(
+                    "INCRBY", false, 2, 1, command_begin));
+            }},
+        {"DECR",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new IncrementCommandParser(
+                    "DECR", false, 1, -1, command_begin));
+            }},
+        {"DECRBY",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new IncrementCommandParser(
+                    "DECRBY", false, 2, -1, command_begin));
+            }},
+        {"HINCRBY",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new IncrementCommandParser(
+                    "HINCRBY", true, 3, 1, command_begin));
+            }},
+    });
+    for (auto const& i: INCREMENT_COMMANDS) {
+        STD_COMMANDS.erase(i.first);
+        TRANSACTION_MULTI_KEY_COMMANDS.insert(i.first);
+        SPECIAL_RSP.insert(i);
+    }
+}
+
+void Command::compress_values()
+{
+    static std::map<std::string, CmdCreateFn> const READ_COMMANDS(
+    {
+        {"GET",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new DecompressCommandParser("GET", 1, command_begin));
+            }},
+        {"HGET",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new DecompressCommandParser("HGET", 2, command_begin));
+            }},
+    });
+    static std::map<std::string, CmdCreateFn> const WRITE_COMMANDS(
+    {
+        {"SET",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("SET", 1, false, command_begin));
+            }},
+        {"SETNX",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("SETNX", 1, false, command_begin));
+            }},
+        {"SETEX",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("SETEX", 2, false, command_begin));
+            }},
+        {"PSETEX",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("PSETEX", 2, false, command_begin));
+            }},
+        {"HSET",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("HSET", 2, true, command_begin));
+            }},
+        {"HSETNX",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("HSETNX", 2, false, command_begin));
+            }},
+        {"HMSET",
+            [](Buffer::iterator command_begin, Buffer::iterator) -> CmdPtr
+            {
+                return util::mkptr(new CompressCommandParser("HMSET", 2, true, command_begin));
+            }},
+    });
+    auto intercept = [](std::map<std::string, CmdCreateFn> const& commands)
+    {
+        for (auto const& i: commands) {
+            STD_COMMANDS.erase(i.first);
+            TRANSACTION_MULTI_KEY_COMMANDS.insert(i.first);
+            SPECIAL_RSP.insert(i);
+        }
+    };
+    if (STD_COMMANDS.find("SET") != STD_COMMANDS.end()) {
+        intercept(WRITE_COMMANDS);
+    }
+    intercept(READ_COMMANDS);
+}
@@ -4,8 +4,10 @@
 #include <set>
 #include <vector>
 
+#include "common.hpp"
 #include "utils/pointer.h"
 #include "buffer.hpp"
+#include "trace.hpp"
 
 namespace cerb {
 
@@ -39,6 +41,10 @@ namespace cerb {
         Command(Command const&) = delete;
 
         static void allow_write_commands();
+        /* call after allow_write_commands; see coalesce.hpp */
+        static void coalesce_increments();
+        /* call after allow_write_commands; see compression.hpp */
+        static void compress_values();
     };
 
     class DataCommand
@@ -56,6 +62,39 @@ namespace cerb {
         Time sent_time;
         Time resp_time;
 
+        virtual slot key_slot() const = 0;
+
+        /*
+         * Replies the server sends ahead of the one to this command, such
+         * as those to MULTI and queued commands; they are passed to
+         * on_leading_reply, and moved is set for MOVED, ASK or CLUSTERDOWN
+         * errors, which are not retried
+         */
+        virtual msize_t leading_replies() const
+        {
+            return 0;
+        }
+
+        virtual void on_leading_reply(Buffer const&, bool) {}
+
+        /*
+         * whether the reply could be passed on to the client as it arrives;
+         * if so, on_remote_responsed is called with nothing at last
+         */
+        virtual bool reply_streamable() const
+        {
+            return false;
+        }
+
+        /*
+         * whether the command could be sent again on MOVED, ASK or a lost
+         * connection; if not, the client is closed instead
+         */
+        virtual bool retriable() const
+        {
+            return true;
+        }
+
         Interval remote_cost() const
         {
             return resp_time - sent_time;
@@ -65,11 +104,22 @@ namespace cerb {
     class CommandGroup {
     public:
         util::sref<Client> const client;
+        Time const creation;
+        util::sptr<CommandTrace> trace;
 
         explicit CommandGroup(util::sref<Client> cli)
             : client(cli)
+            , creation(Clock::now())
+            , trace(nullptr)
         {}
 
+        void trace_stage(TraceStage s)
+        {
+            if (this->trace.not_nul()) {
+                this->trace->stage(s);
+            }
+        }
+
         CommandGroup(CommandGroup const&) = delete;
         virtual ~CommandGroup() = default;
 
@@ -79,15 +129,67 @@ namespace cerb {
         }
 
         virtual void deliver_client(Proxy*) {}
+        /* later groups of the client are not sent until this is replied */
+        virtual bool holds_pipeline() const
+        {
+            return false;
+        }
         virtual bool wait_remote() const = 0;
         virtual void select_remote(Proxy* proxy) = 0;
         virtual void append_buffer_to(BufferSet& b) = 0;
         virtual int total_buffer_size() const = 0;
         virtual void command_responsed() = 0;
+        /* called with the command replied, before command_responsed */
+        virtual void command_replied(util::sref<Command>) {}
         virtual void collect_stats(Proxy*) const {}
     };
 
+    /* commands a client queued between MULTI and EXEC */
+    struct Transaction {
+        Buffer commands;
+        msize_t count;
+        slot key_slot;
+        bool aborted;
+
+        Transaction()
+            : count(0)
+            , key_slot(0)
+            , aborted(false)
+        {}
+    };
+
+    /* replies to commands of a client in bulk mode, see PROXY BULK */
+    struct BulkIngest {
+        static msize_t const MAX_ERRORS = 16;
+
+        uint64_t ok;
+        uint64_t errors;
+        std::vector<std::string> first_errors;
+
+        BulkIngest()
+            : ok(0)
+            , errors(0)
+        {}
+
+        void error(std::string e)
+        {
+            ++this->errors;
+            if (this->first_errors.size() < MAX_ERRORS) {
+                this->first_errors.push_back(std::move(e));
+            }
+        }
+    };
+
     void split_client_command(Buffer& buffer, util::sref<Client> cli);
+    /*
+     * If the buffer begins with an incomplete request of a single key
+     * command, of which the key is complete, returns a group of it to be
+     * passed on as it arrives, and sets cmd to the command, which is not
+     * retriable; the request is not in the command buffer. Otherwise
+     * returns nul.
+     */
+    util::sptr<CommandGroup> stream_client_command(
+        Buffer& buffer, util::sref<Client> cli, util::sref<DataCommand>& cmd);
 
 }
 
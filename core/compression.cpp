@@ -0,0 +1,110 @@
+#include <cctype>
+#include <cstring>
+
+#include "compression.hpp"
+#include "globals.hpp"
+#include "utils/lz4.hpp"
+#include "utils/logging.hpp"
+#include "utils/string.h"
+
+using namespace cerb;
+
+namespace {
+
+    /* a NUL leads, so that textual values never look compressed */
+    char const MAGIC[] = {'\0', 'C', 'Z', '\1'};
+    msize_t const MAGIC_LEN = sizeof MAGIC;
+    /* the magic, then the original length in 4 bytes, little endian */
+    msize_t const HEADER_LEN = MAGIC_LEN + 4;
+    /* an LZ4 block expands at most about 255 times */
+    msize_t const MAX_EXPANSION = 255;
+
+}
+
+bool cerb::compress_key(std::string const& key)
+{
+    for (std::string const& prefix: cerb_global::compress_prefixes) {
+        if (key.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cerb::compress_value(char const* value, msize_t len, std::string& out)
+{
+    if (len < cerb_global::compress_min_bytes || len > UINT32_MAX) {
+        return false;
+    }
+    Time start = Clock::now();
+    std::string block(util::lz4_compress(value, len));
+    bool compressed = HEADER_LEN + block.size() < len;
+    if (compressed) {
+        out.reserve(HEADER_LEN + block.size());
+        out.assign(MAGIC, MAGIC_LEN);
+        for (int i = 0; i < 4; ++i) {
+            out += char(len >> (i * 8));
+        }
+        out += block;
+    }
+    int64_t ns = stat_ns_since(start);
+    cerb_global::thread_stats.update(
+        [&](ThreadStats::Writer& w)
+        {
+            w.add(STAT_COMPRESSED_VALUES, compressed ? 1 : 0);
+            w.add(STAT_COMPRESS_INPUT_BYTES, len);
+            w.add(STAT_COMPRESS_OUTPUT_BYTES, compressed ? out.size() : len);
+            w.add(STAT_COMPRESS_NS, ns);
+        });
+    return compressed;
+}
+
+void cerb::decompress_reply(Buffer& rsp)
+{
+    Buffer::iterator i = rsp.begin();
+    if (rsp.size() < HEADER_LEN || *i != '$') {
+        return;
+    }
+    msize_t len = 0;
+    for (++i; i != rsp.end() && std::isdigit(*i); ++i) {
+        len = len * 10 + (*i - '0');
+    }
+    if (rsp.end() - i < 2 || *i != '\r' || msize_t(rsp.end() - i) != len + 4) {
+        return;
+    }
+    char const* value = reinterpret_cast<char const*>(&*(i + 2));
+    if (len < HEADER_LEN || std::memcmp(value, MAGIC, MAGIC_LEN) != 0) {
+        return;
+    }
+    Time start = Clock::now();
+    msize_t origin_len = 0;
+    for (int k = 0; k < 4; ++k) {
+        origin_len |= msize_t(byte(value[MAGIC_LEN + k])) << (k * 8);
+    }
+    if (origin_len > (len - HEADER_LEN) * MAX_EXPANSION) {
+        LOG(WARNING) << "Invalid length of a compressed value: " << origin_len;
+        return;
+    }
+
+    /* decode directly into the reply, without an intermediate copy */
+    std::string head("$" + util::str(origin_len) + "\r\n");
+    Buffer decoded;
+    decoded.resize(head.size() + origin_len + 2);
+    char* d = static_cast<char*>(decoded.data());
+    std::memcpy(d, head.data(), head.size());
+    if (!util::lz4_decompress(value + HEADER_LEN, len - HEADER_LEN,
+                              d + head.size(), origin_len))
+    {
+        LOG(WARNING) << "Corrupted compressed value of " << len << " bytes";
+        return;
+    }
+    std::memcpy(d + head.size() + origin_len, "\r\n", 2);
+    rsp.swap(decoded);
+    int64_t ns = stat_ns_since(start);
+    cerb_global::thread_stats.update(
+        [&](ThreadStats::Writer& w)
+        {
+            w.add(STAT_DECOMPRESSED_VALUES, 1);
+            w.add(STAT_DECOMPRESS_NS, ns);
+        });
+}
@@ -0,0 +1,23 @@
+#ifndef __CERBERUS_COMPRESSION_HPP__
+#define __CERBERUS_COMPRESSION_HPP__
+
+#include <string>
+
+#include "buffer.hpp"
+
+namespace cerb {
+
+    /*
+     * Values of keys under compress-prefixes of at least compress-min-bytes
+     * are stored as a magic header, the original length and an LZ4 block,
+     * if that is smaller than the value.
+     */
+    bool compress_key(std::string const& key);
+    /* returns false, leaving out unchanged, if the value is not to be compressed */
+    bool compress_value(char const* value, msize_t len, std::string& out);
+    /* decodes a bulk string reply of a compressed value in place */
+    void decompress_reply(Buffer& rsp);
+
+}
+
+#endif /* __CERBERUS_COMPRESSION_HPP__ */
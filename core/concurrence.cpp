@@ -8,15 +8,17 @@ using namespace cerb;
 ListenThread::ListenThread(int listen_port)
     : _proxy(new Proxy(listen_port))
     , _thread(nullptr)
-    , _mem_buffer_stat(nullptr)
+    , _stats(nullptr)
 {}
 
 void ListenThread::run()
 {
+    this->_proxy->listen_wakeups();
     this->_thread.reset(new std::thread(
         [this]()
         {
-            _mem_buffer_stat = &cerb_global::allocated_buffer;
+            cerb_global::thread_stats.set(STAT_ACCEPTING, this->_proxy->accepting());
+            _stats.store(&cerb_global::thread_stats, std::memory_order_release);
             try {
                 poll::pevent events[poll::MAX_EVENTS];
                 while (true) {
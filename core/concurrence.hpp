@@ -1,6 +1,7 @@
 #ifndef __CERBERUS_CONCURRENCE_HPP__
 #define __CERBERUS_CONCURRENCE_HPP__
 
+#include <atomic>
 #include <thread>
 
 #include "common.hpp"
@@ -12,7 +13,7 @@ namespace cerb {
     class ListenThread {
         util::sptr<Proxy> _proxy;
         util::sptr<std::thread> _thread;
-        msize_t const* _mem_buffer_stat;
+        std::atomic<ThreadStats const*> _stats;
     public:
         explicit ListenThread(int listen_port);
         ListenThread(ListenThread const&) = delete;
@@ -20,7 +21,7 @@ namespace cerb {
         ListenThread(ListenThread&& rhs)
             : _proxy(std::move(rhs._proxy))
             , _thread(std::move(rhs._thread))
-            , _mem_buffer_stat(rhs._mem_buffer_stat)
+            , _stats(rhs._stats.load())
         {}
 
         void run();
@@ -36,9 +37,16 @@ namespace cerb {
             return *_proxy;
         }
 
-        msize_t buffer_allocated() const
+        /* null before the thread starts */
+        ThreadStats const* stats() const
         {
-            return *_mem_buffer_stat;
+            return _stats.load(std::memory_order_acquire);
+        }
+
+        StatsSnapshot stats_snapshot() const
+        {
+            ThreadStats const* s = this->stats();
+            return s == nullptr ? StatsSnapshot() : s->snapshot();
         }
     };
 
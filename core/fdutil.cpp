@@ -1,5 +1,9 @@
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
 #include "fdutil.hpp"
 #include "syscalls/cio.h"
+#include "utils/address.hpp"
 #include "utils/logging.hpp"
 
 using namespace cerb;
@@ -22,3 +26,17 @@ void FDWrapper::close()
         this->fd = -1;
     }
 }
+
+std::string cerb::peer_address(int fd)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof addr;
+    if (fd == -1 || ::getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+        return "?";
+    }
+    char host[INET_ADDRSTRLEN];
+    if (::inet_ntop(AF_INET, &addr.sin_addr, host, sizeof host) == nullptr) {
+        return "?";
+    }
+    return util::Address(host, ntohs(addr.sin_port)).str();
+}
@@ -1,6 +1,8 @@
 #ifndef __CERBERUS_FILE_DESCRIPTER_UTILITY_HPP__
 #define __CERBERUS_FILE_DESCRIPTER_UTILITY_HPP__
 
+#include <string>
+
 namespace cerb {
 
     class FDWrapper {
@@ -19,6 +21,9 @@ namespace cerb {
         void close();
     };
 
+    /* "host:port" of the peer of a socket, or "?" if unknown */
+    std::string peer_address(int fd);
+
 }
 
 #endif /* __CERBERUS_FILE_DESCRIPTER_UTILITY_HPP__ */
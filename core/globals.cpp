@@ -4,11 +4,37 @@
 #include "globals.hpp"
 
 std::vector<cerb::ListenThread> cerb_global::all_threads;
-thread_local cerb::msize_t cerb_global::allocated_buffer(0);
+thread_local cerb::ThreadStats cerb_global::thread_stats;
 
 thread_local cerb::Time cerb_global::poll_start;
 cerb::Interval cerb_global::slow_poll_elapse;
 
+cerb::Interval cerb_global::slowlog_slower_than(std::chrono::milliseconds(10));
+cerb::msize_t cerb_global::slowlog_max_len(128);
+
+cerb::msize_t cerb_global::trace_sample_rate(0);
+cerb::msize_t cerb_global::trace_max_len(1024);
+
+cerb::msize_t cerb_global::scatter_max_bytes(64 * 1024 * 1024);
+cerb::msize_t cerb_global::reply_stream_window(1024 * 1024);
+cerb::msize_t cerb_global::request_stream_window(0);
+cerb::Interval cerb_global::request_stream_timeout(std::chrono::milliseconds(5000));
+cerb::msize_t cerb_global::noreply_max_pending_bytes(64 * 1024 * 1024);
+cerb::msize_t cerb_global::max_request_args(1024 * 1024);
+cerb::msize_t cerb_global::max_fanout_keys(0);
+cerb::msize_t cerb_global::fanout_window(1024);
+cerb::Interval cerb_global::shed_target(0);
+cerb::Interval cerb_global::shed_interval(std::chrono::milliseconds(100));
+cerb::msize_t cerb_global::shed_max_queue(0);
+std::set<std::string> cerb_global::shed_priority_commands;
+
+std::vector<std::string> cerb_global::coalesce_prefixes;
+cerb::Interval cerb_global::coalesce_window(std::chrono::milliseconds(2));
+bool cerb_global::coalesce_ack(false);
+
+std::vector<std::string> cerb_global::compress_prefixes;
+cerb::msize_t cerb_global::compress_min_bytes(1024);
+
 static std::mutex remote_addrs_mutex;
 static std::set<util::Address> remote_addrs;
 static std::atomic_bool cluster_ok(false);
@@ -3,8 +3,10 @@
 
 #include <set>
 #include <vector>
+#include <string>
 
 #include "common.hpp"
+#include "stats.hpp"
 #include "concurrence.hpp"
 #include "utils/pointer.h"
 #include "utils/address.hpp"
@@ -12,11 +14,48 @@
 namespace cerb_global {
 
     extern std::vector<cerb::ListenThread> all_threads;
-    extern thread_local cerb::msize_t allocated_buffer;
+    extern thread_local cerb::ThreadStats thread_stats;
 
     extern thread_local cerb::Time poll_start;
     extern cerb::Interval slow_poll_elapse;
 
+    extern cerb::Interval slowlog_slower_than;
+    extern cerb::msize_t slowlog_max_len;
+
+    extern cerb::msize_t trace_sample_rate;
+    extern cerb::msize_t trace_max_len;
+
+    extern cerb::msize_t scatter_max_bytes;
+    /* replies larger than this are passed on as they arrive, if not 0 */
+    extern cerb::msize_t reply_stream_window;
+    /* requests larger than this are passed on as they arrive, if not 0 */
+    extern cerb::msize_t request_stream_window;
+    /* a client streaming a request is closed if it sends nothing for this long */
+    extern cerb::Interval request_stream_timeout;
+    /* bytes waiting on a no-reply connection, over which writes get replies */
+    extern cerb::msize_t noreply_max_pending_bytes;
+    extern cerb::msize_t max_request_args;
+    /* multiple key commands of more keys are refused, if not 0 */
+    extern cerb::msize_t max_fanout_keys;
+    /* commands of a multiple key command in flight to each node, if not 0 */
+    extern cerb::msize_t fanout_window;
+
+    /* see load_shedder.hpp; shedding by sojourn is off if the target is 0 */
+    extern cerb::Interval shed_target;
+    extern cerb::Interval shed_interval;
+    extern cerb::msize_t shed_max_queue;
+    extern std::set<std::string> shed_priority_commands;
+
+    /* increments of keys with these prefixes are coalesced if not empty */
+    extern std::vector<std::string> coalesce_prefixes;
+    extern cerb::Interval coalesce_window;
+    /* reply OK at once instead of the value after the increment */
+    extern bool coalesce_ack;
+
+    /* values of keys with these prefixes are compressed if not empty */
+    extern std::vector<std::string> compress_prefixes;
+    extern cerb::msize_t compress_min_bytes;
+
     void set_remotes(std::set<util::Address> remotes);
     std::set<util::Address> get_remotes();
 
@@ -0,0 +1,62 @@
+#include "load_shedder.hpp"
+#include "globals.hpp"
+#include "utils/logging.hpp"
+
+using namespace cerb;
+
+void LoadShedder::_set_overloaded(bool overloaded)
+{
+    if (this->_overloaded == overloaded) {
+        return;
+    }
+    this->_overloaded = overloaded;
+    cerb_global::thread_stats.add(STAT_OVERLOADED, overloaded ? 1 : -1);
+    if (overloaded) {
+        LOG(WARNING) << "Overloaded, shed commands for "
+                     << cerb_global::thread_stats.get(STAT_QUEUED_COMMANDS)
+                     << " commands awaiting replies";
+    } else {
+        LOG(INFO) << "Not overloaded any more";
+    }
+}
+
+void LoadShedder::on_replied(Interval sojourn, Time now)
+{
+    if (cerb_global::shed_target == Interval(0)) {
+        return;
+    }
+    if (sojourn < cerb_global::shed_target) {
+        this->_above_since = Time();
+        return this->_set_overloaded(false);
+    }
+    if (this->_above_since == Time()) {
+        this->_above_since = now;
+    } else if (now - this->_above_since >= cerb_global::shed_interval) {
+        this->_set_overloaded(true);
+    }
+}
+
+bool LoadShedder::admit(std::string const& cmd)
+{
+    int64_t queued = cerb_global::thread_stats.get(STAT_QUEUED_COMMANDS);
+    if (cerb_global::shed_max_queue != 0 && queued >= int64_t(cerb_global::shed_max_queue)) {
+        cerb_global::thread_stats.add(STAT_SHED_QUEUE_FULL, 1);
+        return false;
+    }
+    if (!this->_overloaded) {
+        return true;
+    }
+    if (queued == 0) {
+        /* no more sojourn to know of until a command is admitted */
+        this->_above_since = Time();
+        this->_set_overloaded(false);
+        return true;
+    }
+    if (cerb_global::shed_priority_commands.find(cmd) !=
+        cerb_global::shed_priority_commands.end())
+    {
+        return true;
+    }
+    cerb_global::thread_stats.add(STAT_SHED_COMMANDS, 1);
+    return false;
+}
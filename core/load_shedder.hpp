@@ -0,0 +1,43 @@
+#ifndef __CERBERUS_LOAD_SHEDDER_HPP__
+#define __CERBERUS_LOAD_SHEDDER_HPP__
+
+#include <string>
+
+#include "common.hpp"
+
+namespace cerb {
+
+    /*
+     * Admission control of a thread, in the way of CoDel. The sojourn of a
+     * command is the time from the proxy reading it to a node replying it;
+     * if it stays above shed-target for shed-interval, the thread is
+     * overloaded, and new commands to nodes are rejected with BUSY, except
+     * those of shed-priority-commands, until a command is replied within
+     * the target or no command of the thread awaits replies. Apart from
+     * that, commands are rejected while shed-max-queue of them are awaiting.
+     */
+    class LoadShedder {
+        Time _above_since;
+        bool _overloaded;
+
+        void _set_overloaded(bool overloaded);
+    public:
+        LoadShedder()
+            : _overloaded(false)
+        {}
+
+        LoadShedder(LoadShedder const&) = delete;
+
+        bool overloaded() const
+        {
+            return this->_overloaded;
+        }
+
+        void on_replied(Interval sojourn, Time now);
+        /* cmd is the command name in upper case */
+        bool admit(std::string const& cmd);
+    };
+
+}
+
+#endif /* __CERBERUS_LOAD_SHEDDER_HPP__ */
@@ -0,0 +1,314 @@
+#include <fnmatch.h>
+#include <sys/timerfd.h>
+#include <algorithm>
+#include <cppformat/format.h>
+
+#include "monitor.hpp"
+#include "client.hpp"
+#include "proxy.hpp"
+#include "slowlog.hpp"
+#include "globals.hpp"
+#include "except/exceptions.hpp"
+#include "utils/logging.hpp"
+#include "utils/spsc_ring.hpp"
+#include "syscalls/poll.h"
+
+using namespace cerb;
+
+std::atomic<int> cerb::monitors_attached(0);
+
+namespace {
+
+    int const MAX_MONITORS = 16;
+    msize_t const RING_SIZE = 1024;
+    msize_t const MAX_OUTPUT = 4 * 1024 * 1024;
+    long const TICK_NS = 10 * 1000 * 1000;
+
+    struct MonitorEntry {
+        int64_t time_us;
+        int argc;
+        char client[SlowLogEntry::ADDR_SIZE];
+        char args[SlowLogEntry::ARGS_SIZE];
+    };
+
+    typedef util::SpscRing<MonitorEntry> Ring;
+
+    /*
+     * A sink is claimed by one monitor at a time and reused afterwards.
+     * Its rings, one for each proxy thread, are allocated before the sink
+     * is activated for the first time and never freed, so a proxy thread
+     * that still sees the sink active after it is detached writes to valid
+     * memory; such stale entries are discarded by the next monitor.
+     */
+    struct Sink {
+        std::atomic<bool> claimed;
+        std::atomic<bool> active;
+        std::atomic<msize_t> sample_rate;
+        std::atomic<uint64_t> dropped;
+        std::vector<util::sptr<Ring>> rings;
+    };
+
+    Sink sinks[MAX_MONITORS];
+
+    int thread_ring_index()
+    {
+        static std::atomic<int> next_index(0);
+        thread_local int const index = next_index.fetch_add(1);
+        return index;
+    }
+
+    int64_t now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /* quote an argument like redis does for MONITOR */
+    void append_repr(std::string& out, char const* p, msize_t len)
+    {
+        out += '"';
+        for (msize_t i = 0; i < len; ++i) {
+            char c = p[i];
+            switch (c) {
+            case '\\':
+            case '"':
+                out += '\\';
+                out += c;
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (0x20 <= byte(c) && byte(c) < 0x7f) {
+                    out += c;
+                } else {
+                    out += fmt::format("\\x{:02x}", byte(c));
+                }
+            }
+        }
+        out += '"';
+    }
+
+    bool matches(MonitorEntry const& e, std::string const& pattern)
+    {
+        if (pattern.empty()) {
+            return true;
+        }
+        char const* p = e.args;
+        for (int i = 0; i < e.argc; ++i) {
+            msize_t len = byte(*p++);
+            std::string arg(p, len);
+            p += len;
+            if (i == 0) {
+                std::transform(arg.begin(), arg.end(), arg.begin(), ::toupper);
+            }
+            if (::fnmatch(pattern.c_str(), arg.c_str(), 0) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string format_entry(MonitorEntry const& e)
+    {
+        std::string line(fmt::format("+{}.{:06d} [0 {}]", e.time_us / 1000000,
+                                     e.time_us % 1000000, e.client));
+        char const* p = e.args;
+        for (int i = 0; i < e.argc; ++i) {
+            msize_t len = byte(*p++);
+            line += ' ';
+            ::append_repr(line, p, len);
+            p += len;
+        }
+        return line + "\r\n";
+    }
+
+}
+
+void cerb::monitor_feed_command(util::sref<Client> c, Buffer::iterator begin,
+                                Buffer::iterator end)
+{
+    thread_local msize_t counters[MAX_MONITORS] = {0};
+    MonitorEntry e;
+    bool packed = false;
+    for (int i = 0; i < MAX_MONITORS; ++i) {
+        Sink& s = ::sinks[i];
+        if (!s.active.load(std::memory_order_acquire)) {
+            continue;
+        }
+        msize_t rate = s.sample_rate.load(std::memory_order_relaxed);
+        if (rate > 1 && ++counters[i] % rate != 0) {
+            continue;
+        }
+        if (!packed) {
+            e.time_us = ::now_us();
+            e.argc = pack_args(begin, end, e.args, SlowLogEntry::ARGS_SIZE);
+            msize_t len = std::min(c->address().size(), msize_t(SlowLogEntry::ADDR_SIZE - 1));
+            std::copy(c->address().begin(), c->address().begin() + len, e.client);
+            e.client[len] = '\0';
+            packed = true;
+        }
+        msize_t index = ::thread_ring_index();
+        if (index >= s.rings.size() || !s.rings[index]->push(e)) {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            cerb_global::thread_stats.add(STAT_MONITOR_DROPPED, 1);
+        }
+    }
+}
+
+int Monitor::attach(msize_t sample_rate)
+{
+    for (int i = 0; i < MAX_MONITORS; ++i) {
+        Sink& s = ::sinks[i];
+        bool claimed = false;
+        if (!s.claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire)) {
+            continue;
+        }
+        if (s.rings.empty()) {
+            for (msize_t t = 0; t < cerb_global::all_threads.size(); ++t) {
+                s.rings.push_back(util::mkptr(new Ring(RING_SIZE)));
+            }
+        }
+        MonitorEntry stale;
+        for (auto& r: s.rings) {
+            while (r->pop(stale))
+                ;
+        }
+        s.sample_rate.store(sample_rate, std::memory_order_relaxed);
+        s.active.store(true, std::memory_order_release);
+        monitors_attached.fetch_add(1, std::memory_order_relaxed);
+        return i;
+    }
+    return -1;
+}
+
+Monitor::Monitor(Proxy* p, int clientfd, int sink, std::string pattern)
+    : ProxyConnection(clientfd)
+    , _proxy(p)
+    , _sink(sink)
+    , _pattern(std::move(pattern))
+    , _reported_drops(::sinks[sink].dropped.load(std::memory_order_relaxed))
+    , _ticker(this)
+{
+    this->_output.append(std::make_shared<Buffer>(Buffer("+OK\r\n")));
+    p->poll_add_ro(&this->_ticker);
+    p->poll_add_rw(this);
+    LOG(DEBUG) << "Start monitor " << this->str();
+}
+
+Monitor::~Monitor()
+{
+    Sink& s = ::sinks[this->_sink];
+    s.active.store(false, std::memory_order_relaxed);
+    monitors_attached.fetch_sub(1, std::memory_order_relaxed);
+    s.claimed.store(false, std::memory_order_release);
+}
+
+void Monitor::_drain()
+{
+    Sink& s = ::sinks[this->_sink];
+    std::string out;
+    MonitorEntry e;
+    for (auto& r: s.rings) {
+        while (this->_output.size() + out.size() < MAX_OUTPUT && r->pop(e)) {
+            if (::matches(e, this->_pattern)) {
+                out += ::format_entry(e);
+            }
+        }
+    }
+    uint64_t dropped = s.dropped.load(std::memory_order_relaxed);
+    if (dropped != this->_reported_drops) {
+        int64_t now = ::now_us();
+        out += fmt::format("+{}.{:06d} [proxy] \"dropped\" \"{}\"\r\n", now / 1000000,
+                           now % 1000000, dropped - this->_reported_drops);
+        this->_reported_drops = dropped;
+    }
+    if (!out.empty()) {
+        this->_output.append(std::make_shared<Buffer>(Buffer(out)));
+    }
+    this->_flush();
+}
+
+void Monitor::_flush()
+{
+    if (this->_output.empty() || this->_output.writev(this->fd)) {
+        this->_proxy->set_conn_poll_ro(this);
+    } else {
+        this->_proxy->set_conn_poll_rw(this);
+    }
+}
+
+void Monitor::on_events(int events)
+{
+    if (poll::event_is_hup(events)) {
+        return this->on_error();
+    }
+    if (poll::event_is_read(events)) {
+        Buffer b;
+        if (b.read(this->fd) == 0) {
+            LOG(DEBUG) << "Monitor quit because read 0 bytes";
+            return this->on_error();
+        }
+    }
+    if (poll::event_is_write(events)) {
+        this->_flush();
+    }
+}
+
+void Monitor::after_events(std::set<Connection*>& active_conns)
+{
+    if (this->closed()) {
+        active_conns.erase(&this->_ticker);
+        delete this;
+    }
+}
+
+std::string Monitor::str() const
+{
+    return fmt::format("Monitor({}@{})[sink={}]", this->fd, static_cast<void const*>(this),
+                       this->_sink);
+}
+
+Monitor::Ticker::Ticker(Monitor* peer)
+    : ProxyConnection(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+    , _peer(peer)
+{
+    if (this->fd == -1) {
+        throw SystemError("timerfd_create", errno);
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = TICK_NS;
+    spec.it_value = spec.it_interval;
+    if (::timerfd_settime(this->fd, 0, &spec, nullptr) == -1) {
+        throw SystemError("timerfd_settime", errno);
+    }
+}
+
+void Monitor::Ticker::on_events(int)
+{
+    uint64_t expirations;
+    cio::read(this->fd, &expirations, sizeof expirations);
+    this->_peer->_drain();
+}
+
+void Monitor::Ticker::after_events(std::set<Connection*>& active_conns)
+{
+    if (this->closed() || this->_peer->closed()) {
+        active_conns.erase(this->_peer);
+        delete this->_peer;
+    }
+}
+
+std::string Monitor::Ticker::str() const
+{
+    return fmt::format("MonitorTicker({}@{})=M({}@{})", this->fd,
+                       static_cast<void const*>(this), this->_peer->fd,
+                       static_cast<void const*>(this->_peer));
+}
@@ -0,0 +1,73 @@
+#ifndef __CERBERUS_MONITOR_HPP__
+#define __CERBERUS_MONITOR_HPP__
+
+#include <atomic>
+
+#include "connection.hpp"
+#include "buffer.hpp"
+#include "utils/pointer.h"
+
+namespace cerb {
+
+    class Proxy;
+    class Client;
+
+    /* commands are passed to monitors only if this is not 0 */
+    extern std::atomic<int> monitors_attached;
+
+    void monitor_feed_command(util::sref<Client> c, Buffer::iterator begin,
+                              Buffer::iterator end);
+
+    inline void monitor_feed(util::sref<Client> c, Buffer::iterator begin,
+                             Buffer::iterator end)
+    {
+        if (monitors_attached.load(std::memory_order_relaxed) != 0) {
+            monitor_feed_command(c, begin, end);
+        }
+    }
+
+    /*
+     * A client in MONITOR state. Each proxy thread passes sampled commands
+     * into its own ring of the monitor; the monitor drains all the rings on
+     * every tick of a timer in its own thread. A full ring drops the command
+     * rather than blocking, and drops are reported to the client inline.
+     */
+    class Monitor
+        : public ProxyConnection
+    {
+        class Ticker
+            : public ProxyConnection
+        {
+            Monitor* const _peer;
+        public:
+            explicit Ticker(Monitor* peer);
+
+            void on_events(int events);
+            void after_events(std::set<Connection*>& active_conns);
+            std::string str() const;
+        };
+
+        Proxy* const _proxy;
+        int const _sink;
+        std::string const _pattern;
+        BufferSet _output;
+        uint64_t _reported_drops;
+        Ticker _ticker;
+
+        void _drain();
+        void _flush();
+    public:
+        /* returns -1 if no more monitor could be attached */
+        static int attach(msize_t sample_rate);
+
+        Monitor(Proxy* p, int clientfd, int sink, std::string pattern);
+        ~Monitor();
+
+        void on_events(int events);
+        void after_events(std::set<Connection*>& active_conns);
+        std::string str() const;
+    };
+
+}
+
+#endif /* __CERBERUS_MONITOR_HPP__ */
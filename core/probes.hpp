@@ -0,0 +1,41 @@
+#ifndef __CERBERUS_PROBES_HPP__
+#define __CERBERUS_PROBES_HPP__
+
+/*
+ * USDT probes of provider "cerberus", built in with `make USDT=1`
+ * (requires sys/sdt.h, e.g. from systemtap-sdt-dev).
+ * An unattached probe is a single nop; otherwise the macros expand to nothing.
+ * Arguments are evaluated whenever probes are built in, so pass only values
+ * at hand, not ones that need formatting.
+ *
+ * Probes:
+ *   client__accept(int fd)
+ *   client__close(int fd)                           not for clients turned into
+ *                                                   long connections
+ *   command__parsed(char const* name, int slot)     slot is -1 if not keyed
+ *   command__sent(char const* host, int port, int slot)
+ *   reply__received(char const* host, int port, int slot, long remote_us)
+ *   moved__ask(char const* error)
+ *   slot__map__installed(int nodes)
+ *   slow__poll(long elapse_us, int events)
+ */
+
+#ifdef _USE_USDT_PROBES
+
+# include <sys/sdt.h>
+
+# define CERB_PROBE1(name, a) DTRACE_PROBE1(cerberus, name, a)
+# define CERB_PROBE2(name, a, b) DTRACE_PROBE2(cerberus, name, a, b)
+# define CERB_PROBE3(name, a, b, c) DTRACE_PROBE3(cerberus, name, a, b, c)
+# define CERB_PROBE4(name, a, b, c, d) DTRACE_PROBE4(cerberus, name, a, b, c, d)
+
+#else
+
+# define CERB_PROBE1(name, a)
+# define CERB_PROBE2(name, a, b)
+# define CERB_PROBE3(name, a, b, c)
+# define CERB_PROBE4(name, a, b, c, d)
+
+#endif
+
+#endif /* __CERBERUS_PROBES_HPP__ */
@@ -1,10 +1,14 @@
+#include <sys/resource.h>
+#include <sys/eventfd.h>
 #include <cppformat/format.h>
 
 #include "proxy.hpp"
 #include "server.hpp"
 #include "client.hpp"
 #include "response.hpp"
+#include "coalesce.hpp"
 #include "globals.hpp"
+#include "probes.hpp"
 #include "except/exceptions.hpp"
 #include "utils/string.h"
 #include "utils/alg.hpp"
@@ -15,6 +19,8 @@
 
 using namespace cerb;
 
+static Interval const CPU_SAMPLE_INTERVAL(std::chrono::milliseconds(100));
+
 SlotsMapUpdater::SlotsMapUpdater(util::Address a, Proxy* p)
     : Connection(fctl::new_stream_socket())
     , _proxy(p)
@@ -105,18 +111,40 @@ std::string SlotsMapUpdater::str() const
                        static_cast<void const*>(this), this->addr.str());
 }
 
+ProxyWaker::ProxyWaker(Proxy* p)
+    : Connection(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (this->fd == -1) {
+        throw SystemError("eventfd", errno);
+    }
+    p->poll_add_ro(this);
+}
+
+void ProxyWaker::on_events(int)
+{
+    uint64_t n;
+    cio::read(this->fd, &n, sizeof n);
+}
+
+void ProxyWaker::wake()
+{
+    uint64_t n = 1;
+    cio::write(this->fd, &n, sizeof n);
+}
+
+std::string ProxyWaker::str() const
+{
+    return fmt::format("ProxyWaker({}@{})", this->fd, static_cast<void const*>(this));
+}
+
 Proxy::Proxy(int listen_port)
-    : _clients_count(0)
-    , _long_conns_count(0)
-    , _total_cmd_elapse(0)
-    , _total_remote_cost(0)
-    , _total_cmd(0)
-    , _last_cmd_elapse(0)
-    , _last_remote_cost(0)
-    , _slot_map_expired(true)
+    : _slot_map_expired(true)
     , _fd_closed(false)
+    , _waker(nullptr)
     , epfd(poll::poll_create())
     , acceptor(this, listen_port)
+    , slow_log(cerb_global::slowlog_max_len)
+    , tracer(cerb_global::trace_max_len)
 {
     this->acceptor.turn_on_accepting();
 }
@@ -126,10 +154,23 @@ Proxy::~Proxy()
     cio::close(epfd);
 }
 
+void Proxy::listen_wakeups()
+{
+    this->_waker.reset(new ProxyWaker(this));
+}
+
+void Proxy::wakeup()
+{
+    if (this->_waker.not_nul()) {
+        this->_waker->wake();
+    }
+}
+
 void Proxy::_set_slot_map(std::vector<RedisNode> const& map,
                           std::set<util::Address> const& remotes)
 {
     _server_map.replace_map(map, this);
+    CERB_PROBE1(slot__map__installed, int(map.size()));
     _slot_map_expired = false;
     cerb_global::set_remotes(std::move(remotes));
     cerb_global::set_cluster_ok(true);
@@ -218,12 +259,15 @@ void Proxy::_retrieve_slot_map()
 void Proxy::notify_slot_map_updated(std::vector<RedisNode> const& nodes,
                                     std::set<util::Address> const& remotes, msize_t covered_slots)
 {
+    Time start = Clock::now();
     if (covered_slots < CLUSTER_SLOT_COUNT) {
         LOG(INFO) << fmt::format("Discard result because only {} slots covered", covered_slots);
-        return this->_update_slot_map_failed();
+        this->_update_slot_map_failed();
+    } else {
+        this->_set_slot_map(nodes, remotes);
+        this->_move_closed_slot_updaters();
     }
-    this->_set_slot_map(nodes, remotes);
-    this->_move_closed_slot_updaters();
+    cerb_global::thread_stats.add(STAT_SLOT_MAP_NS, stat_ns_since(start));
 }
 
 void Proxy::update_slot_map()
@@ -252,10 +296,24 @@ void Proxy::_move_closed_slot_updaters()
 
 void Proxy::retry_move_ask_command_later(util::sref<DataCommand> cmd)
 {
+    if (!cmd->retriable()) {
+        LOG(ERROR) << "Streamed request not retried, close " << cmd->group->client->str();
+        return cmd->group->client->abort();
+    }
     LOG(DEBUG) << "Retry later: " << cmd.id().str() << " for " << cmd->group->client->str();
     this->_retrying_commands.push_back(cmd);
 }
 
+void Proxy::cancel_retry(util::sref<DataCommand> cmd)
+{
+    util::erase_if(
+        this->_retrying_commands,
+        [&](util::sref<DataCommand> c)
+        {
+            return c.is(cmd);
+        });
+}
+
 void Proxy::inactivate_long_conn(Connection* conn)
 {
     this->_inactive_long_connections.insert(conn);
@@ -287,8 +345,17 @@ void Proxy::handle_events(poll::pevent events[], int nfds)
         this->_fd_closed = true;
     }
     std::set<Connection*> closed_conns(std::move(this->_inactive_long_connections));
+    this->clients.take_kills(
+        [&](Client* c)
+        {
+            LOG(DEBUG) << "Kill " << c->str();
+            c->close();
+            closed_conns.insert(c);
+            delete c;
+        });
 
     cerb_global::poll_start = Clock::now();
+    int64_t slot_map_ns = cerb_global::thread_stats.get(STAT_SLOT_MAP_NS);
     for (int i = 0; i < nfds; ++i) {
         Connection* conn = static_cast<Connection*>(events[i].data.ptr);
         LOG(DEBUG) << "*poll process " << conn->str();
@@ -305,15 +372,22 @@ void Proxy::handle_events(poll::pevent events[], int nfds)
         }
     }
     LOG(DEBUG) << "*poll clean";
+    Time on_events_end = Clock::now();
+    /* slot map updated in events handling is counted separately */
+    int64_t on_events_ns = stat_ns(on_events_end - cerb_global::poll_start)
+        - (cerb_global::thread_stats.get(STAT_SLOT_MAP_NS) - slot_map_ns);
 
     ::poll_ctl(this, std::move(this->_conn_poll_type));
     for (Connection* c: active_conns) {
         c->after_events(active_conns);
     }
+    int64_t after_events_ns = stat_ns_since(on_events_end);
     this->_finished_slot_updaters.clear();
     if (this->_should_update_slot_map()) {
         LOG(DEBUG) << "Should update slot map";
+        Time start = Clock::now();
         this->_retrieve_slot_map();
+        cerb_global::thread_stats.add(STAT_SLOT_MAP_NS, stat_ns_since(start));
         /* do it again after try updating slot map
          * because some client may get CLUSTERDOWN message when no available remotes
          */
@@ -324,10 +398,15 @@ void Proxy::handle_events(poll::pevent events[], int nfds)
         this->acceptor.turn_on_accepting();
     }
     auto poll_elapse = Clock::now() - cerb_global::poll_start;
+    this->_stat_loop(nfds, poll_elapse, on_events_ns, after_events_ns);
     if (cerb_global::slow_poll_elapse < poll_elapse) {
+        CERB_PROBE2(slow__poll, long(std::chrono::duration_cast<
+                        std::chrono::microseconds>(poll_elapse).count()), nfds);
         LOG(INFO) << fmt::format(
             "Poll elapse={} events={} clients={} long_clients={} slots_map_updated={}",
-            util::str(poll_elapse), nfds, this->_clients_count, this->_long_conns_count,
+            util::str(poll_elapse), nfds,
+            cerb_global::thread_stats.get(STAT_CLIENTS),
+            cerb_global::thread_stats.get(STAT_LONG_CONNECTIONS),
             cerb_global::cluster_ok());
     }
     LOG(DEBUG) << "*poll done";
@@ -342,8 +421,9 @@ Server* Proxy::get_server_by_slot(slot key_slot)
 void Proxy::new_client(int client_fd)
 {
     LOG(DEBUG) << fmt::format("ACCEPT CLIENT fd={}", client_fd);
+    CERB_PROBE1(client__accept, client_fd);
     new Client(client_fd, this);
-    ++this->_clients_count;
+    cerb_global::thread_stats.add(STAT_CLIENTS, 1);
 }
 
 void Proxy::pop_client(Client* cli)
@@ -355,21 +435,71 @@ void Proxy::pop_client(Client* cli)
         {
             return cmd->group->client.is(cli);
         });
-    --this->_clients_count;
+    coalesce_pop_client(cli);
+    cerb_global::thread_stats.add(STAT_CLIENTS, -1);
     this->_fd_closed = true;
 }
 
+void Proxy::_stat_loop(int nfds, Interval elapse, int64_t on_events_ns,
+                       int64_t after_events_ns)
+{
+    ThreadStats& stats = cerb_global::thread_stats;
+    stats.update(
+        [&](ThreadStats::Writer& w)
+        {
+            w.add(STAT_LOOP_ITERATIONS, 1);
+            w.add(STAT_POLLED_EVENTS, nfds);
+            w.add(STAT_ON_EVENTS_NS, on_events_ns);
+            w.add(STAT_AFTER_EVENTS_NS, after_events_ns);
+        });
+    stats.loop_elapse_hist.record(stat_ns(elapse) / 1000);
+
+    /* getrusage is a real syscall, so sample thread CPU time now and then */
+    if (cerb_global::poll_start - this->_last_cpu_sample < CPU_SAMPLE_INTERVAL) {
+        return;
+    }
+    this->_last_cpu_sample = cerb_global::poll_start;
+    struct rusage usage;
+    if (::getrusage(RUSAGE_THREAD, &usage) == 0) {
+        stats.update(
+            [&](ThreadStats::Writer& w)
+            {
+                w.set(STAT_CPU_USER_US, usage.ru_utime.tv_sec * 1000000L + usage.ru_utime.tv_usec);
+                w.set(STAT_CPU_SYS_US, usage.ru_stime.tv_sec * 1000000L + usage.ru_stime.tv_usec);
+            });
+    }
+}
+
 void Proxy::stat_proccessed(Interval cmd_elapse, Interval remote_cost)
 {
-    _total_cmd_elapse += cmd_elapse;
-    ++_total_cmd;
-    _last_cmd_elapse = cmd_elapse;
-    _total_remote_cost += remote_cost;
-    _last_remote_cost = remote_cost;
+    int64_t cmd_elapse_ns = stat_ns(cmd_elapse);
+    int64_t remote_cost_ns = stat_ns(remote_cost);
+    cerb_global::thread_stats.update(
+        [&](ThreadStats::Writer& w)
+        {
+            w.add(STAT_COMPLETED_COMMANDS, 1);
+            w.add(STAT_CMD_ELAPSE_NS, cmd_elapse_ns);
+            w.set(STAT_LAST_CMD_ELAPSE_NS, cmd_elapse_ns);
+            w.add(STAT_REMOTE_COST_NS, remote_cost_ns);
+            w.set(STAT_LAST_REMOTE_COST_NS, remote_cost_ns);
+        });
+    cerb_global::thread_stats.cmd_elapse_hist.record(cmd_elapse_ns / 1000);
+    cerb_global::thread_stats.remote_cost_hist.record(remote_cost_ns / 1000);
+}
+
+void Proxy::incr_long_conn()
+{
+    cerb_global::thread_stats.add(STAT_LONG_CONNECTIONS, 1);
+}
+
+void Proxy::decr_long_conn()
+{
+    cerb_global::thread_stats.add(STAT_LONG_CONNECTIONS, -1);
 }
 
 void Proxy::poll_add_ro(Connection* conn)
 {
+    cerb_global::thread_stats.add(STAT_EPOLL_CTL_CALLS, 1);
     if (poll::poll_add_read(this->epfd, conn->fd, conn)) {
         throw cerb::SystemError("poll r+" + conn->str(), errno);
     }
@@ -377,6 +507,7 @@ void Proxy::poll_add_ro(Connection* conn)
 
 void Proxy::poll_add_rw(Connection* conn)
 {
+    cerb_global::thread_stats.add(STAT_EPOLL_CTL_CALLS, 1);
     if (poll::poll_add_write(this->epfd, conn->fd, conn)) {
         throw cerb::SystemError("poll rw+" + conn->str(), errno);
     }
@@ -384,6 +515,7 @@ void Proxy::poll_add_rw(Connection* conn)
 
 void Proxy::poll_ro(Connection* conn)
 {
+    cerb_global::thread_stats.add(STAT_EPOLL_CTL_CALLS, 1);
     if (poll::poll_read(this->epfd, conn->fd, conn)) {
         throw cerb::SystemError("poll r*" + conn->str(), errno);
     }
@@ -391,6 +523,7 @@ void Proxy::poll_ro(Connection* conn)
 
 void Proxy::poll_rw(Connection* conn)
 {
+    cerb_global::thread_stats.add(STAT_EPOLL_CTL_CALLS, 1);
     if (poll::poll_write(this->epfd, conn->fd, conn)) {
         throw cerb::SystemError("poll rw*" + conn->str(), errno);
     }
@@ -398,5 +531,6 @@ void Proxy::poll_rw(Connection* conn)
 
 void Proxy::poll_del(Connection* conn)
 {
+    cerb_global::thread_stats.add(STAT_EPOLL_CTL_CALLS, 1);
     poll::poll_del(this->epfd, conn->fd);
 }
@@ -6,6 +6,11 @@
 
 #include "command.hpp"
 #include "slot_map.hpp"
+#include "slowlog.hpp"
+#include "trace.hpp"
+#include "slot_stats.hpp"
+#include "load_shedder.hpp"
+#include "client_registry.hpp"
 #include "connection.hpp"
 #include "acceptor.hpp"
 #include "utils/pointer.h"
@@ -64,23 +69,32 @@ namespace cerb {
         }
     };
 
-    class Proxy {
-        int _clients_count;
-        int _long_conns_count;
+    /* an eventfd that other threads write to interrupt the poll of a proxy */
+    class ProxyWaker
+        : public Connection
+    {
+    public:
+        explicit ProxyWaker(Proxy* p);
 
+        void on_events(int);
+        void on_error() {}
+        std::string str() const;
+
+        /* any thread */
+        void wake();
+    };
+
+    class Proxy {
         SlotMap _server_map;
         std::vector<util::sptr<SlotsMapUpdater>> _slot_updaters;
         std::vector<util::sptr<SlotsMapUpdater>> _finished_slot_updaters;
         std::vector<util::sref<DataCommand>> _retrying_commands;
         std::set<Connection*> _inactive_long_connections;
-        Interval _total_cmd_elapse;
-        Interval _total_remote_cost;
-        long _total_cmd;
-        Interval _last_cmd_elapse;
-        Interval _last_remote_cost;
         bool _slot_map_expired;
         bool _fd_closed;
+        Time _last_cpu_sample;
         std::map<Connection*, bool> _conn_poll_type;
+        util::sptr<ProxyWaker> _waker;
 
         bool _should_update_slot_map() const;
         void _retrieve_slot_map();
@@ -89,9 +103,16 @@ namespace cerb {
         void _update_slot_map_failed();
         void _update_slot_map();
         void _move_closed_slot_updaters();
+        void _stat_loop(int nfds, Interval elapse, int64_t on_events_ns,
+                        int64_t after_events_ns);
     public:
         int epfd;
         Acceptor acceptor;
+        SlowLog slow_log;
+        Tracer tracer;
+        SlotStats slot_stats;
+        ClientRegistry clients;
+        LoadShedder shedder;
 
         explicit Proxy(int listen_port);
         ~Proxy();
@@ -108,59 +129,27 @@ namespace cerb {
             _conn_poll_type[conn] = true;
         }
 
-        int clients_count() const
-        {
-            return _clients_count;
-        }
-
         bool accepting() const
         {
             return this->acceptor.accepting();
         }
 
-        void incr_long_conn()
-        {
-            ++this->_long_conns_count;
-        }
+        /* called before the thread runs */
+        void listen_wakeups();
+        /* any thread; makes the proxy handle events soon, even if idle */
+        void wakeup();
 
-        void decr_long_conn()
-        {
-            --this->_long_conns_count;
-        }
+        void incr_long_conn();
+        void decr_long_conn();
 
-        int long_conns_count() const
-        {
-            return this->_long_conns_count;
-        }
-
-        long total_cmd() const
-        {
-            return _total_cmd;
-        }
-
-        Interval total_cmd_elapse() const
-        {
-            return _total_cmd_elapse;
-        }
-
-        Interval total_remote_cost() const
-        {
-            return _total_remote_cost;
-        }
-
-        Interval last_cmd_elapse() const
-        {
-            return _last_cmd_elapse;
-        }
-
-        Interval last_remote_cost() const
+        Server* random_addr()
         {
-            return _last_remote_cost;
+            return _server_map.random_addr();
         }
 
-        Server* random_addr()
+        std::vector<slot> node_slots() const
         {
-            return _server_map.random_addr();
+            return _server_map.node_slots();
         }
 
         Server* get_server_by_slot(slot key_slot);
@@ -169,6 +158,7 @@ namespace cerb {
                                      msize_t covered_slots);
         void update_slot_map();
         void retry_move_ask_command_later(util::sref<DataCommand> cmd);
+        void cancel_retry(util::sref<DataCommand> cmd);
         void inactivate_long_conn(Connection* conn);
         void handle_events(poll::pevent events[], int nfds);
         void new_client(int client_fd);
@@ -1,7 +1,11 @@
+#include <algorithm>
+
 #include "response.hpp"
 #include "command.hpp"
 #include "proxy.hpp"
 #include "message.hpp"
+#include "probes.hpp"
+#include "except/exceptions.hpp"
 #include "utils/string.h"
 #include "utils/address.hpp"
 #include "utils/logging.hpp"
@@ -86,6 +90,7 @@ namespace {
                     util::stristartswith(_last_error, "CLUSTERDOWN"))
                 {
                     LOG(DEBUG) << "Retry due to " << _last_error;
+                    CERB_PROBE1(moved__ask, _last_error.c_str());
                     return this->_push_retry_rsp();
                 }
             }
@@ -123,3 +128,63 @@ std::vector<util::sptr<Response>> cerb::split_server_response(Buffer& buffer)
     }
     return std::move(r.responses);
 }
+
+void ReplyScanner::_element_done()
+{
+    while (!this->_elements.empty()) {
+        if (--this->_elements.back() != 0) {
+            return;
+        }
+        this->_elements.pop_back();
+    }
+    this->_finished = true;
+}
+
+msize_t ReplyScanner::scan(Buffer::const_iterator begin, Buffer::const_iterator end)
+{
+    Buffer::const_iterator i = begin;
+    while (!this->_finished && i != end) {
+        if (this->_bulk_remaining != 0) {
+            msize_t n = std::min(this->_bulk_remaining, msize_t(end - i));
+            i += n;
+            this->_bulk_remaining -= n;
+            if (this->_bulk_remaining == 0) {
+                this->_element_done();
+            }
+            continue;
+        }
+        Buffer::const_iterator line_end = std::find(i, end, byte('\n'));
+        if (line_end == end) {
+            break;
+        }
+        switch (*i) {
+        case '+':
+        case '-':
+        case ':':
+            this->_element_done();
+            break;
+        case '$': {
+            rint len = msg::btoi(i + 1, line_end + 1).first;
+            if (len < 0) {
+                this->_element_done();
+            } else {
+                this->_bulk_remaining = len + msg::LENGTH_OF_CR_LF;
+            }
+            break;
+        }
+        case '*': {
+            rint count = msg::btoi(i + 1, line_end + 1).first;
+            if (count <= 0) {
+                this->_element_done();
+            } else {
+                this->_elements.push_back(count);
+            }
+            break;
+        }
+        default:
+            throw BadRedisMessage(*i);
+        }
+        i = line_end + 1;
+    }
+    return i - begin;
+}
@@ -27,6 +27,36 @@ namespace cerb {
 
     std::vector<util::sptr<Response>> split_server_response(Buffer& buffer);
 
+    /*
+     * Follows one reply arriving in pieces without keeping it, so that its
+     * bytes could be passed on before it completes
+     */
+    class ReplyScanner {
+        /* elements not yet seen of each array the scanner is in */
+        std::vector<rint> _elements;
+        /* bytes of the current bulk string and its CRLF not yet seen */
+        msize_t _bulk_remaining;
+        bool _finished;
+
+        void _element_done();
+    public:
+        ReplyScanner()
+            : _bulk_remaining(0)
+            , _finished(false)
+        {}
+
+        /*
+         * returns how many bytes from begin belong to the reply, short of an
+         * incomplete line, which shall be passed in again with more bytes
+         */
+        msize_t scan(Buffer::const_iterator begin, Buffer::const_iterator end);
+
+        bool finished() const
+        {
+            return this->_finished;
+        }
+    };
+
 }
 
 #endif /* __CERBERUS_RESPONSE_HPP__ */
@@ -0,0 +1,106 @@
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+
+#include "script_cache.hpp"
+
+using namespace cerb;
+
+/* sources of all threads; written only by SCRIPT LOAD and SCRIPT FLUSH */
+static std::mutex scripts_mutex;
+static std::map<std::string, std::string> sources;
+/* bumped whenever sources change, so threads copy them only then */
+static std::atomic<uint64_t> sources_version(0);
+/* bumped by SCRIPT FLUSH, so threads drop what they know of nodes */
+static std::atomic<uint64_t> flush_generation(0);
+
+namespace {
+
+    struct ThreadScripts {
+        uint64_t sources_version;
+        uint64_t flush_generation;
+        std::map<std::string, std::string> sources;
+        std::map<util::Address, std::set<std::string>> loaded;
+
+        ThreadScripts()
+            : sources_version(0)
+            , flush_generation(0)
+        {}
+
+        void sync_flush()
+        {
+            uint64_t g = ::flush_generation.load(std::memory_order_acquire);
+            if (g != this->flush_generation) {
+                this->flush_generation = g;
+                this->loaded.clear();
+                this->sources.clear();
+            }
+        }
+
+        void sync_sources()
+        {
+            if (::sources_version.load(std::memory_order_acquire) == this->sources_version) {
+                return;
+            }
+            std::lock_guard<std::mutex> _(::scripts_mutex);
+            this->sources = ::sources;
+            this->sources_version = ::sources_version.load(std::memory_order_relaxed);
+        }
+    };
+
+    thread_local ThreadScripts thread_scripts;
+
+}
+
+void cerb::script_record(std::string const& sha, std::string const& source)
+{
+    thread_scripts.sync_flush();
+    thread_scripts.sources[sha] = source;
+    std::lock_guard<std::mutex> _(::scripts_mutex);
+    ::sources[sha] = source;
+    ::sources_version.fetch_add(1, std::memory_order_release);
+}
+
+bool cerb::script_source(std::string const& sha, std::string& source)
+{
+    thread_scripts.sync_flush();
+    auto i = thread_scripts.sources.find(sha);
+    if (i == thread_scripts.sources.end()) {
+        thread_scripts.sync_sources();
+        i = thread_scripts.sources.find(sha);
+        if (i == thread_scripts.sources.end()) {
+            return false;
+        }
+    }
+    source = i->second;
+    return true;
+}
+
+bool cerb::script_loaded_on(util::Address const& node, std::string const& sha)
+{
+    thread_scripts.sync_flush();
+    auto i = thread_scripts.loaded.find(node);
+    return i != thread_scripts.loaded.end() && i->second.find(sha) != i->second.end();
+}
+
+void cerb::script_set_loaded(util::Address const& node, std::string const& sha, bool loaded)
+{
+    thread_scripts.sync_flush();
+    if (loaded) {
+        thread_scripts.loaded[node].insert(sha);
+    } else {
+        thread_scripts.loaded[node].erase(sha);
+    }
+}
+
+void cerb::script_flush()
+{
+    {
+        std::lock_guard<std::mutex> _(::scripts_mutex);
+        ::sources.clear();
+        ::sources_version.fetch_add(1, std::memory_order_release);
+    }
+    ::flush_generation.fetch_add(1, std::memory_order_release);
+    thread_scripts.sync_flush();
+}
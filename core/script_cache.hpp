@@ -0,0 +1,25 @@
+#ifndef __CERBERUS_SCRIPT_CACHE_HPP__
+#define __CERBERUS_SCRIPT_CACHE_HPP__
+
+#include <string>
+
+#include "utils/address.hpp"
+
+namespace cerb {
+
+    /*
+     * Sources of scripts loaded via SCRIPT LOAD, shared by all threads, and
+     * the nodes known to have them cached, kept by each thread so EVALSHA
+     * takes no lock; a thread copies the sources only after they change.
+     * SHA1 digests are in lower case.
+     */
+    void script_record(std::string const& sha, std::string const& source);
+    /* returns false if the source of sha is unknown */
+    bool script_source(std::string const& sha, std::string& source);
+    bool script_loaded_on(util::Address const& node, std::string const& sha);
+    void script_set_loaded(util::Address const& node, std::string const& sha, bool loaded);
+    void script_flush();
+
+}
+
+#endif /* __CERBERUS_SCRIPT_CACHE_HPP__ */
@@ -1,4 +1,5 @@
 #include <map>
+#include <algorithm>
 #include <cppformat/format.h>
 
 #include "command.hpp"
@@ -6,6 +7,9 @@
 #include "client.hpp"
 #include "proxy.hpp"
 #include "response.hpp"
+#include "message.hpp"
+#include "globals.hpp"
+#include "probes.hpp"
 #include "except/exceptions.hpp"
 #include "utils/alg.hpp"
 #include "utils/logging.hpp"
@@ -22,7 +26,7 @@ void Server::on_events(int events)
     if (poll::event_is_hup(events)) {
         return this->close_conn();
     }
-    if (poll::event_is_read(events)) {
+    if (poll::event_is_read(events) && !this->_stream_paused) {
         try {
             this->_recv_from();
         } catch (BadRedisMessage& e) {
@@ -34,34 +38,95 @@ void Server::on_events(int events)
         }
     }
     this->_push_to_buffer_set();
-    if (poll::event_is_write(events)) {
-        this->_output_buffer_set.writev(this->fd);
+    if (poll::event_is_write(events) && this->_output_buffer_set.writev(this->fd)) {
+        for (util::sref<DataCommand> c: this->_traced_unwritten) {
+            c->group->trace_stage(TRACE_SERVER_WRITTEN);
+        }
+        this->_traced_unwritten.clear();
     }
-    if (this->_output_buffer_set.empty()) {
-        this->_proxy->set_conn_poll_ro(this);
-    } else {
+    if (this->_request_source != nullptr && this->_request_writing &&
+        this->_output_buffer_set.size() < cerb_global::request_stream_window)
+    {
+        this->_request_source->resume_request();
+        this->_request_source = nullptr;
+    }
+    if (!this->_output_buffer_set.empty()) {
         this->_proxy->set_conn_poll_rw(this);
+    } else if (!this->_stream_paused) {
+        /* polling again would report the pending reply before resumed */
+        this->_proxy->set_conn_poll_ro(this);
     }
 }
 
+/* whether the entry before i awaits more replies, as its command is also at i */
+static bool has_more_replies(util::sref<DataCommand> c,
+                             std::vector<util::sref<DataCommand>>::iterator i,
+                             std::vector<util::sref<DataCommand>>::iterator end)
+{
+    return i != end && i->is(c);
+}
+
 void Server::_push_to_buffer_set()
 {
     auto now = Clock::now();
-    for (util::sref<DataCommand> c: this->_commands) {
-        this->_sent_commands.push_back(c);
+    auto i = this->_commands.begin();
+    /* commands after a streamed request wait until it is complete */
+    for (; i != this->_commands.end() && !this->_request_writing; ++i) {
+        util::sref<DataCommand> c = *i;
+        /* one entry for each reply; all but the last are leading replies */
+        this->_sent_commands.insert(this->_sent_commands.end(), c->leading_replies() + 1, c);
         this->_output_buffer_set.append(c->buffer);
         c->sent_time = now;
+        CERB_PROBE3(command__sent, this->addr.host.c_str(), this->addr.port,
+                    int(c->key_slot()));
+        if (c->group->trace.not_nul()) {
+            this->_traced_unwritten.push_back(c);
+        }
+        if (c.is(this->_request_stream)) {
+            this->_request_writing = true;
+        }
     }
-    this->_commands.clear();
+    this->_commands.erase(this->_commands.begin(), i);
 }
 
+/*
+ * With reply-stream-window set, at most a window is read at first so that
+ * a large reply could be streamed from its beginning, and so is each time
+ * while streaming; the socket is then read again, as it is edge triggered
+ */
 void Server::_recv_from()
 {
-    int n = this->_buffer.read(this->fd);
+    msize_t window = cerb_global::reply_stream_window;
+    msize_t n = this->_buffer.read(this->fd, window == 0 ? msize_t(-1) : window);
     if (n == 0) {
         throw ConnectionHungUp();
     }
+    this->_on_received();
+    while (window != 0 && n >= window && !this->closed() && !this->_stream_paused) {
+        n = this->_buffer.read(this->fd, this->_streaming ? window : msize_t(-1));
+        if (n == 0) {
+            return;
+        }
+        this->_on_received();
+    }
+}
+
+void Server::_on_received()
+{
     LOG(DEBUG) << "Read " << this->str() << " buffer size " << this->_buffer.size();
+    while (true) {
+        if (this->_streaming && !this->_stream_reply()) {
+            return;
+        }
+        if (!this->_split_replies() || !this->_start_stream()) {
+            return;
+        }
+    }
+}
+
+/* returns false if the connection is closed */
+bool Server::_split_replies()
+{
     auto responses(split_server_response(this->_buffer));
     if (responses.size() > this->_sent_commands.size()) {
         LOG(ERROR) << "+Error on split, expected size: " << this->_sent_commands.size()
@@ -70,7 +135,8 @@ void Server::_recv_from()
             LOG(ERROR) << "::: " << rsp->get_buffer().to_string();
         }
         LOG(ERROR) << "Rest buffer: " << this->_buffer.to_string();
-        return this->close_conn();
+        this->close_conn();
+        return false;
     }
     LOG(DEBUG) << "+responses size: " << responses.size();
     LOG(DEBUG) << "+rest buffer: " << this->_buffer.size();
@@ -78,28 +144,219 @@ void Server::_recv_from()
     auto now = Clock::now();
     for (util::sptr<Response>& rsp: responses) {
         util::sref<DataCommand> c = *cmd_it++;
-        if (c.not_nul()) {
+        if (c.not_nul() && ::has_more_replies(c, cmd_it, this->_sent_commands.end())) {
+            if (rsp->server_moved()) {
+                /* the command is not retried, while the slot map is stale */
+                this->_proxy->update_slot_map();
+            }
+            c->on_leading_reply(rsp->get_buffer(), rsp->server_moved());
+        } else if (c.not_nul()) {
+            this->_command_replied(c, rsp->get_buffer().size(), now);
             rsp->rsp_to(c, util::mkref(*this->_proxy));
-            c->resp_time = now;
         }
     }
     this->_sent_commands.erase(this->_sent_commands.begin(), cmd_it);
+    return !this->closed();
+}
+
+void Server::_command_replied(util::sref<DataCommand> c, msize_t reply_size, Time now)
+{
+    c->resp_time = now;
+    CERB_PROBE4(reply__received, this->addr.host.c_str(), this->addr.port,
+                int(c->key_slot()), long(std::chrono::duration_cast<
+                    std::chrono::microseconds>(c->remote_cost()).count()));
+    if (c->group->trace.not_nul()) {
+        c->group->trace_stage(TRACE_REPLY_RECEIVED);
+        util::erase_if(this->_traced_unwritten,
+                       [&](util::sref<DataCommand> u) { return u.is(c); });
+    }
+    this->_proxy->slot_stats.record(c->key_slot(), c->buffer->size() + reply_size);
+    this->_proxy->shedder.on_replied(now - c->group->creation, now);
+    if (SlowLog::slow(now - c->group->creation)) {
+        this->_proxy->slow_log.record(c, this->addr, now);
+    }
+}
+
+/*
+ * The rest of the buffer is the beginning of the reply to the command at
+ * the head; if it is already larger than the window, pass it on from now
+ * on, unless the reply would be changed before sent to the client, or the
+ * client has replies to former commands not yet complete. Errors, such as
+ * MOVED, are always awaited entirely.
+ */
+bool Server::_start_stream()
+{
+    if (cerb_global::reply_stream_window == 0 || this->_sent_commands.empty() ||
+        this->_buffer.size() < cerb_global::reply_stream_window)
+    {
+        return false;
+    }
+    byte type = *this->_buffer.begin();
+    if (type != '$' && type != '*') {
+        return false;
+    }
+    util::sref<DataCommand> c = this->_sent_commands.front();
+    if (c.not_nul() && !(c->reply_streamable() && c->group->client->stream_ready(c->group))) {
+        return false;
+    }
+    LOG(DEBUG) << "Stream reply from " << this->str();
+    this->_streaming = true;
+    this->_stream_command = c;
+    this->_stream_scanner = ReplyScanner();
+    cerb_global::thread_stats.add(STAT_STREAMED_REPLIES, 1);
+    return true;
+}
+
+/* returns whether the streamed reply is complete */
+bool Server::_stream_reply()
+{
+    msize_t n = this->_stream_scanner.scan(this->_buffer.begin(), this->_buffer.end());
+    if (n != 0) {
+        Buffer chunk;
+        if (n == this->_buffer.size()) {
+            chunk.swap(this->_buffer);
+        } else {
+            chunk = Buffer(this->_buffer.begin(), this->_buffer.begin() + n);
+            this->_buffer.truncate_from_begin(this->_buffer.begin() + n);
+        }
+        this->_stream_bytes += n;
+        cerb_global::thread_stats.add(STAT_STREAMED_BYTES, n);
+        if (this->_stream_command.not_nul() && !this->_stream_command->group->client
+                ->stream_reply(std::move(chunk), this))
+        {
+            this->_stream_paused = !this->_stream_scanner.finished();
+        }
+    }
+    if (!this->_stream_scanner.finished()) {
+        return false;
+    }
+    util::sref<DataCommand> c = this->_stream_command;
+    msize_t reply_size = this->_stream_bytes;
+    this->_stop_stream();
+    this->_sent_commands.erase(this->_sent_commands.begin());
+    if (c.not_nul()) {
+        this->_command_replied(c, reply_size, Clock::now());
+        c->on_remote_responsed(Buffer(), false);
+    }
+    return true;
+}
+
+void Server::_stop_stream()
+{
+    this->_streaming = false;
+    this->_stream_paused = false;
+    this->_stream_command.reset();
+    this->_stream_bytes = 0;
+}
+
+void Server::resume_stream()
+{
+    if (!this->_stream_paused) {
+        return;
+    }
+    this->_stream_paused = false;
+    /* polling again reports the reply left in the socket */
+    if (this->_output_buffer_set.empty()) {
+        this->_proxy->set_conn_poll_ro(this);
+    } else {
+        this->_proxy->set_conn_poll_rw(this);
+    }
+}
+
+void Server::start_request_stream(util::sref<DataCommand> cmd)
+{
+    this->_request_stream = cmd;
+    this->_request_writing = false;
+}
+
+bool Server::stream_request(Buffer chunk, bool complete, Client* cli)
+{
+    msize_t pending;
+    if (this->_request_writing) {
+        this->_output_buffer_set.append(std::make_shared<Buffer>(std::move(chunk)));
+        pending = this->_output_buffer_set.size();
+    } else {
+        /* not yet written, as commands before it are not */
+        this->_request_stream->buffer->append_from(chunk.begin(), chunk.end());
+        pending = this->_request_stream->buffer->size();
+    }
+    this->_proxy->set_conn_poll_rw(this);
+    if (complete) {
+        this->_request_stream.reset();
+        this->_request_writing = false;
+        this->_request_source = nullptr;
+        return true;
+    }
+    if (pending < cerb_global::request_stream_window) {
+        return true;
+    }
+    this->_request_source = cli;
+    return false;
 }
 
 void Server::push_client_command(util::sref<DataCommand> cmd)
 {
     _commands.push_back(cmd);
     cmd->group->client->add_peer(this);
+    cmd->group->trace_stage(TRACE_SERVER_QUEUED);
+}
+
+void Server::cancel_command(util::sref<DataCommand> cmd)
+{
+    if (this->_streaming && this->_stream_command.is(cmd)) {
+        /* a part of the reply is sent already */
+        cmd->group->client->abort();
+        this->_stream_command.reset();
+        this->resume_stream();
+    }
+    util::erase_if(
+        this->_commands,
+        [&](util::sref<DataCommand> c)
+        {
+            return c.is(cmd);
+        });
+    util::erase_if(
+        this->_traced_unwritten,
+        [&](util::sref<DataCommand> c)
+        {
+            return c.is(cmd);
+        });
+    for (util::sref<DataCommand>& c: this->_sent_commands) {
+        if (c.is(cmd)) {
+            c.reset();
+        }
+    }
 }
 
 void Server::pop_client(Client* cli)
 {
+    if (this->_request_source == cli) {
+        this->_request_source = nullptr;
+    }
+    bool request_cut_off = false;
+    if (this->_request_stream.not_nul() && this->_request_stream->group->client.is(cli)) {
+        request_cut_off = this->_request_writing;
+        this->_request_stream.reset();
+        this->_request_writing = false;
+    }
+    if (this->_streaming && this->_stream_command.not_nul() &&
+        this->_stream_command->group->client.is(cli))
+    {
+        this->_stream_command.reset();
+        this->resume_stream();
+    }
     util::erase_if(
         this->_commands,
         [&](util::sref<DataCommand> cmd)
         {
             return cmd->group->client.is(cli);
         });
+    util::erase_if(
+        this->_traced_unwritten,
+        [&](util::sref<DataCommand> cmd)
+        {
+            return cmd->group->client.is(cli);
+        });
     for (util::sref<DataCommand>& cmd: this->_sent_commands) {
         if (cmd.not_nul() &&
             cmd->group.not_nul() &&
@@ -108,6 +365,11 @@ void Server::pop_client(Client* cli)
             cmd.reset();
         }
     }
+    if (request_cut_off) {
+        /* the node would take commands after as the rest of the request */
+        LOG(ERROR) << "Request cut off by " << cli->str() << ", close " << this->str();
+        this->close_conn();
+    }
 }
 
 std::vector<util::sref<DataCommand>> Server::deliver_commands()
@@ -118,6 +380,12 @@ std::vector<util::sref<DataCommand>> Server::deliver_commands()
         {
             return cmd.nul();
         });
+    this->_sent_commands.erase(std::unique(
+        this->_sent_commands.begin(), this->_sent_commands.end(),
+        [](util::sref<DataCommand> a, util::sref<DataCommand> b)
+        {
+            return a.is(b);
+        }), this->_sent_commands.end());
     _commands.insert(_commands.end(), _sent_commands.begin(),
                      _sent_commands.end());
     return std::move(_commands);
@@ -152,14 +420,29 @@ void Server::close_conn()
         this->close();
         this->_buffer.clear();
         this->_output_buffer_set.clear();
+        this->_traced_unwritten.clear();
+        this->_request_stream.reset();
+        this->_request_writing = false;
+        this->_request_source = nullptr;
+
+        if (this->_streaming) {
+            /* not retried, as a part of the reply is sent already */
+            if (this->_stream_command.not_nul()) {
+                LOG(ERROR) << "Reply cut off for " << this->_stream_command->group->client->str();
+                this->_stream_command->group->client->abort();
+            }
+            this->_sent_commands.erase(this->_sent_commands.begin());
+            this->_stop_stream();
+        }
 
         for (util::sref<DataCommand> c: this->_commands) {
             this->_proxy->retry_move_ask_command_later(c);
         }
         this->_commands.clear();
 
-        for (util::sref<DataCommand> c: this->_sent_commands) {
-            if (c.nul()) {
+        for (auto i = this->_sent_commands.begin(); i != this->_sent_commands.end(); ) {
+            util::sref<DataCommand> c = *i++;
+            if (c.nul() || ::has_more_replies(c, i, this->_sent_commands.end())) {
                 continue;
             }
             this->_proxy->retry_move_ask_command_later(c);
@@ -242,3 +525,111 @@ void Server::send_readonly_for_each_conn()
             cmds.push_back(util::sref<DataCommand>(nullptr));
         };
 }
+
+static thread_local std::map<util::Address, NoReplyServer*> noreply_servers_map;
+static std::string const CLIENT_REPLY_OFF_CMD(
+    msg::format_command("CLIENT", std::vector<std::string>({"REPLY", "OFF"})));
+
+NoReplyServer::NoReplyServer(util::Address const& addr, Proxy* p)
+    : ProxyConnection(fctl::new_stream_socket())
+    , _proxy(p)
+    , _unwritten(0)
+    , _pending_bytes(CLIENT_REPLY_OFF_CMD.size())
+    , addr(addr)
+{
+    fctl::set_nonblocking(this->fd);
+    fctl::connect_fd(addr.host, addr.port, this->fd);
+    LOG(INFO) << "Open " << this->str();
+    this->_output_buffer_set.append(std::make_shared<Buffer>(Buffer(CLIENT_REPLY_OFF_CMD)));
+    p->poll_add_rw(this);
+}
+
+NoReplyServer* NoReplyServer::get_server(util::Address const& addr, Proxy* p)
+{
+    auto i = ::noreply_servers_map.find(addr);
+    if (i != ::noreply_servers_map.end() && !i->second->closed()) {
+        return i->second;
+    }
+    NoReplyServer* s;
+    try {
+        s = new NoReplyServer(addr, p);
+    } catch (IOErrorBase& e) {
+        LOG(ERROR) << "Fail to open no-reply server " << addr.str() << " because " << e.what();
+        return nullptr;
+    }
+    ::noreply_servers_map[addr] = s;
+    return s;
+}
+
+bool NoReplyServer::push_command(Buffer cmd)
+{
+    if (this->_pending_bytes + cmd.size() > cerb_global::noreply_max_pending_bytes) {
+        return false;
+    }
+    this->_pending_bytes += cmd.size();
+    this->_output_buffer_set.append(std::make_shared<Buffer>(std::move(cmd)));
+    ++this->_unwritten;
+    cerb_global::thread_stats.add(STAT_NOREPLY_COMMANDS, 1);
+    this->_proxy->set_conn_poll_rw(this);
+    return true;
+}
+
+void NoReplyServer::on_events(int events)
+{
+    if (this->closed()) {
+        return;
+    }
+    if (poll::event_is_hup(events)) {
+        return this->on_error();
+    }
+    if (poll::event_is_read(events)) {
+        /* nothing expected from the node but a close */
+        Buffer b;
+        if (b.read(this->fd) == 0) {
+            LOG(ERROR) << "Read 0 byte on " << this->str();
+            return this->on_error();
+        }
+    }
+    if (poll::event_is_write(events)) {
+        this->_output_buffer_set.writev(this->fd);
+        /* CLIENT REPLY OFF leads, so the rest of the buffers are commands */
+        this->_unwritten = std::min(this->_unwritten,
+                                    this->_output_buffer_set.buffers_count());
+        this->_pending_bytes = this->_output_buffer_set.size();
+    }
+    if (this->_output_buffer_set.empty()) {
+        this->_proxy->set_conn_poll_ro(this);
+    } else {
+        this->_proxy->set_conn_poll_rw(this);
+    }
+}
+
+void NoReplyServer::on_error()
+{
+    if (!this->closed()) {
+        LOG(INFO) << "Close " << this->str() << " dropping " << this->_unwritten << " commands";
+        cerb_global::thread_stats.add(STAT_NOREPLY_DROPPED, this->_unwritten);
+        this->close();
+        this->_output_buffer_set.clear();
+        this->_unwritten = 0;
+        this->_pending_bytes = 0;
+        this->_proxy->update_slot_map();
+    }
+}
+
+void NoReplyServer::after_events(std::set<Connection*>&)
+{
+    if (this->closed()) {
+        auto i = ::noreply_servers_map.find(this->addr);
+        if (i != ::noreply_servers_map.end() && i->second == this) {
+            ::noreply_servers_map.erase(i);
+        }
+        delete this;
+    }
+}
+
+std::string NoReplyServer::str() const
+{
+    return fmt::format("NoReplyServer({}@{})[{}]", this->fd,
+                       static_cast<void const*>(this), this->addr.str());
+}
@@ -6,6 +6,7 @@
 
 #include "proxy.hpp"
 #include "buffer.hpp"
+#include "response.hpp"
 #include "connection.hpp"
 #include "utils/pointer.h"
 #include "utils/address.hpp"
@@ -24,14 +25,50 @@ namespace cerb {
 
         std::vector<util::sref<DataCommand>> _commands;
         std::vector<util::sref<DataCommand>> _sent_commands;
+        /* sampled commands in the output buffer not yet entirely written */
+        std::vector<util::sref<DataCommand>> _traced_unwritten;
+
+        /*
+         * A large reply at the head being passed on to the client as it
+         * arrives; the command is nul if the client is gone, and the rest
+         * of the reply is dropped. Reading is paused while the output of
+         * the client is over reply-stream-window.
+         */
+        bool _streaming;
+        bool _stream_paused;
+        util::sref<DataCommand> _stream_command;
+        ReplyScanner _stream_scanner;
+        msize_t _stream_bytes;
+
+        /*
+         * A request of a client being passed on as it arrives; commands
+         * after it are not written until it is complete. The source client
+         * stops reading while the output is over request-stream-window.
+         */
+        util::sref<DataCommand> _request_stream;
+        bool _request_writing;
+        Client* _request_source;
 
         void _recv_from();
+        void _on_received();
+        bool _split_replies();
+        bool _start_stream();
+        bool _stream_reply();
+        void _stop_stream();
+        void _command_replied(util::sref<DataCommand> c, msize_t reply_size, Time now);
         void _reconnect(util::Address const& addr, Proxy* p);
         void _push_to_buffer_set();
 
         Server()
             : ProxyConnection(-1)
             , _proxy(nullptr)
+            , _streaming(false)
+            , _stream_paused(false)
+            , _stream_command(nullptr)
+            , _stream_bytes(0)
+            , _request_stream(nullptr)
+            , _request_writing(false)
+            , _request_source(nullptr)
             , addr("", 0)
         {}
 
@@ -56,8 +93,22 @@ namespace cerb {
 
         void close_conn();
         void push_client_command(util::sref<DataCommand> cmd);
+        /* the command is not sent if not yet, or its reply is dropped */
+        void cancel_command(util::sref<DataCommand> cmd);
         void pop_client(Client* cli);
         std::vector<util::sref<DataCommand>> deliver_commands();
+        /* called by the client of a streamed reply once its output is written */
+        void resume_stream();
+
+        bool request_stream_ready() const
+        {
+            return this->_request_stream.nul();
+        }
+
+        /* the request of cmd, pushed as a client command, is to be streamed */
+        void start_request_stream(util::sref<DataCommand> cmd);
+        /* returns false if the request is over the window, and cli is resumed once written */
+        bool stream_request(Buffer chunk, bool complete, Client* cli);
 
         void attach_long_connection(ProxyConnection* c)
         {
@@ -72,6 +123,36 @@ namespace cerb {
         }
     };
 
+    /*
+     * A connection to a node that sends CLIENT REPLY OFF at first, on which
+     * commands of no-reply clients are written without awaiting replies.
+     * Commands not yet written when it is closed are dropped.
+     */
+    class NoReplyServer
+        : public ProxyConnection
+    {
+        Proxy* const _proxy;
+        BufferSet _output_buffer_set;
+        /* commands in the output buffer set, not written or partly */
+        msize_t _unwritten;
+        /* bytes in the output buffer set, updated after each write */
+        msize_t _pending_bytes;
+
+        NoReplyServer(util::Address const& addr, Proxy* p);
+    public:
+        util::Address const addr;
+
+        /* returns nullptr if fails to connect */
+        static NoReplyServer* get_server(util::Address const& addr, Proxy* p);
+
+        /* returns false, not taking the command, if over noreply-max-pending-bytes */
+        bool push_command(Buffer cmd);
+        void on_events(int events);
+        void on_error();
+        void after_events(std::set<Connection*>&);
+        std::string str() const;
+    };
+
 }
 
 #endif /* __CERBERUS_SERVER_HPP__ */
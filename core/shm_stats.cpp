@@ -0,0 +1,111 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "shm_stats.hpp"
+#include "globals.hpp"
+#include "except/exceptions.hpp"
+#include "utils/logging.hpp"
+
+using namespace cerb;
+
+static std::string const SHM_DIR("/dev/shm/");
+
+StatsPublisher::StatsPublisher(std::string const& name, Interval interval)
+    : _path(SHM_DIR + name)
+    , _interval(interval)
+    , _header(nullptr)
+    , _values(nullptr)
+    , _map_size(0)
+    , _thread(nullptr)
+{
+    if (name.empty() || name.find('/') != std::string::npos) {
+        throw std::runtime_error("Invalid stats shm name: " + name);
+    }
+    msize_t names_offset = sizeof(cerb_shm_stats_header);
+    msize_t values_offset = names_offset + STAT_FIELDS_COUNT * CERB_SHM_STATS_NAME_LEN;
+    this->_map_size = values_offset +
+        cerb_global::all_threads.size() * STAT_FIELDS_COUNT * sizeof(int64_t);
+
+    /* fill a temporary file then rename it, so readers never see a partial header */
+    std::string tmp_path(this->_path + ".tmp");
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        throw SystemError("open " + tmp_path, errno);
+    }
+    if (::ftruncate(fd, this->_map_size) == -1) {
+        ::close(fd);
+        throw SystemError("ftruncate " + tmp_path, errno);
+    }
+    void* p = ::mmap(nullptr, this->_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        throw SystemError("mmap " + tmp_path, errno);
+    }
+    char* base = static_cast<char*>(p);
+    this->_header = static_cast<cerb_shm_stats_header*>(p);
+    this->_values = reinterpret_cast<int64_t*>(base + values_offset);
+
+    std::memcpy(this->_header->magic, CERB_SHM_STATS_MAGIC, sizeof this->_header->magic);
+    this->_header->version = CERB_SHM_STATS_VERSION;
+    this->_header->thread_count = cerb_global::all_threads.size();
+    this->_header->field_count = STAT_FIELDS_COUNT;
+    this->_header->names_offset = names_offset;
+    this->_header->values_offset = values_offset;
+    this->_header->pid = ::getpid();
+    std::strncpy(this->_header->proxy_version, VERSION,
+                 sizeof this->_header->proxy_version - 1);
+    for (int f = 0; f < STAT_FIELDS_COUNT; ++f) {
+        std::strncpy(base + names_offset + f * CERB_SHM_STATS_NAME_LEN,
+                     stat_field_name(StatField(f)), CERB_SHM_STATS_NAME_LEN - 1);
+    }
+    this->_publish();
+
+    if (::rename(tmp_path.c_str(), this->_path.c_str()) == -1) {
+        throw SystemError("rename " + tmp_path, errno);
+    }
+    LOG(INFO) << "Publish stats to " << this->_path;
+}
+
+StatsPublisher::~StatsPublisher()
+{
+    ::munmap(this->_header, this->_map_size);
+}
+
+void StatsPublisher::_publish()
+{
+    std::vector<StatsSnapshot> stats;
+    for (auto const& thread: cerb_global::all_threads) {
+        stats.push_back(thread.stats_snapshot());
+    }
+    int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uint64_t seq = __atomic_load_n(&this->_header->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_header->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (msize_t t = 0; t < stats.size(); ++t) {
+        for (int f = 0; f < STAT_FIELDS_COUNT; ++f) {
+            __atomic_store_n(&this->_values[t * STAT_FIELDS_COUNT + f],
+                             stats[t].values[f], __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&this->_header->update_time_ms, now_ms, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_header->publish_count,
+                     this->_header->publish_count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&this->_header->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void StatsPublisher::run()
+{
+    this->_thread.reset(new std::thread(
+        [this]()
+        {
+            while (true) {
+                std::this_thread::sleep_for(this->_interval);
+                this->_publish();
+            }
+        }));
+    this->_thread->detach();
+}
@@ -0,0 +1,37 @@
+#ifndef __CERBERUS_SHM_STATS_HPP__
+#define __CERBERUS_SHM_STATS_HPP__
+
+#include <string>
+#include <thread>
+
+#include "common.hpp"
+#include "shm_stats_layout.h"
+#include "utils/pointer.h"
+
+namespace cerb {
+
+    /*
+     * Periodically copies snapshots of all thread stats into a memory mapped
+     * file under /dev/shm, so that local agents read them without any request
+     * to the proxy. The layout is described in shm_stats_layout.h
+     */
+    class StatsPublisher {
+        std::string const _path;
+        Interval const _interval;
+        cerb_shm_stats_header* _header;
+        int64_t* _values;
+        msize_t _map_size;
+        util::sptr<std::thread> _thread;
+
+        void _publish();
+    public:
+        StatsPublisher(std::string const& name, Interval interval);
+        StatsPublisher(StatsPublisher const&) = delete;
+        ~StatsPublisher();
+
+        void run();
+    };
+
+}
+
+#endif /* __CERBERUS_SHM_STATS_HPP__ */
@@ -0,0 +1,48 @@
+#ifndef __CERBERUS_SHM_STATS_LAYOUT_H__
+#define __CERBERUS_SHM_STATS_LAYOUT_H__
+
+#include <stdint.h>
+
+/*
+ * Layout of the stats file published under /dev/shm (see `stats-shm' option)
+ *
+ * All integers are in host byte order. The file consists of
+ *
+ *   offset 0              struct cerb_shm_stats_header
+ *   names_offset          field_count names, CERB_SHM_STATS_NAME_LEN bytes each,
+ *                         NUL padded
+ *   values_offset         thread_count * field_count int64_t values, row by thread,
+ *                         that is value of field f in thread t is at index
+ *                         t * field_count + f
+ *
+ * Everything except `seq', `update_time_ms', `publish_count' and the values
+ * is written once before the file is renamed into place.
+ *
+ * The mutable part is guarded by `seq' as a sequence lock: the publisher
+ * makes it odd before writing and even after. A reader shall
+ *   1. load seq (acquire); retry if odd
+ *   2. copy what it needs
+ *   3. load seq again (after an acquire fence); retry if changed
+ */
+
+#define CERB_SHM_STATS_MAGIC "CERBSTAT"
+#define CERB_SHM_STATS_VERSION 1
+#define CERB_SHM_STATS_NAME_LEN 32
+
+struct cerb_shm_stats_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t thread_count;
+    uint32_t field_count;
+    uint32_t names_offset;
+    uint32_t values_offset;
+    uint32_t reserved;
+    int64_t pid;
+    char proxy_version[32];
+
+    uint64_t seq;
+    int64_t update_time_ms;
+    int64_t publish_count;
+};
+
+#endif /* __CERBERUS_SHM_STATS_LAYOUT_H__ */
@@ -76,6 +76,19 @@ Server* SlotMap::random_addr() const
     return this->_servers[util::randint(0, CLUSTER_SLOT_COUNT)];
 }
 
+std::vector<slot> SlotMap::node_slots() const
+{
+    std::vector<slot> r;
+    std::set<Server*> nodes;
+    for (slot s = 0; s < CLUSTER_SLOT_COUNT; ++s) {
+        Server* svr = this->_servers[s];
+        if (svr != nullptr && nodes.insert(svr).second) {
+            r.push_back(s);
+        }
+    }
+    return r;
+}
+
 static RedisNode parse_node(
     std::string address, std::string node_id, std::string master_id,
     std::vector<std::string>::iterator slot_ranges_begin,
@@ -3,6 +3,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "common.hpp"
 #include "utils/address.hpp"
@@ -83,6 +84,8 @@ namespace cerb {
         void replace_map(std::vector<RedisNode> const& nodes, Proxy* proxy);
         void clear();
         Server* random_addr() const;
+        /* the first slot of each node, in ascending order */
+        std::vector<slot> node_slots() const;
 
         static void select_slave_if_possible(std::string host_beginning);
     };
@@ -0,0 +1,83 @@
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cppformat/format.h>
+
+#include "slot_stats.hpp"
+#include "proxy.hpp"
+#include "server.hpp"
+#include "globals.hpp"
+
+using namespace cerb;
+
+namespace {
+
+    struct SlotTotal {
+        slot key_slot;
+        uint64_t ops;
+        uint64_t bytes;
+    };
+
+    std::string bulk(std::string const& s)
+    {
+        return fmt::format("${}\r\n{}\r\n", s.size(), s);
+    }
+
+    std::string node_of(Proxy* proxy, slot s)
+    {
+        Server* svr = proxy->get_server_by_slot(s);
+        return svr == nullptr ? "" : svr->addr.str();
+    }
+
+}
+
+std::string cerb::slot_stats_report(Proxy* proxy, msize_t top)
+{
+    std::vector<SlotTotal> slots;
+    slots.reserve(CLUSTER_SLOT_COUNT);
+    for (slot s = 0; s < CLUSTER_SLOT_COUNT; ++s) {
+        slots.push_back(SlotTotal{s, 0, 0});
+    }
+    for (auto const& t: cerb_global::all_threads) {
+        SlotStats const& st = t.get_proxy()->slot_stats;
+        for (SlotTotal& s: slots) {
+            s.ops += st.ops(s.key_slot);
+            s.bytes += st.bytes(s.key_slot);
+        }
+    }
+
+    std::map<std::string, SlotTotal> nodes;
+    for (SlotTotal const& s: slots) {
+        if (s.ops == 0) {
+            continue;
+        }
+        SlotTotal& n = nodes.insert(std::make_pair(
+            ::node_of(proxy, s.key_slot), SlotTotal{0, 0, 0})).first->second;
+        n.ops += s.ops;
+        n.bytes += s.bytes;
+    }
+
+    slots.erase(std::remove_if(slots.begin(), slots.end(),
+                               [](SlotTotal const& s) { return s.ops == 0; }),
+                slots.end());
+    std::sort(slots.begin(), slots.end(),
+              [](SlotTotal const& a, SlotTotal const& b)
+              {
+                  return a.ops != b.ops ? a.ops > b.ops : a.key_slot < b.key_slot;
+              });
+    if (slots.size() > top) {
+        slots.resize(top);
+    }
+
+    std::string r(fmt::format("*2\r\n*{}\r\n", slots.size()));
+    for (SlotTotal const& s: slots) {
+        r += fmt::format("*4\r\n:{}\r\n:{}\r\n:{}\r\n{}", s.key_slot, s.ops, s.bytes,
+                         ::bulk(::node_of(proxy, s.key_slot)));
+    }
+    r += fmt::format("*{}\r\n", nodes.size());
+    for (auto const& n: nodes) {
+        r += fmt::format("*3\r\n{}:{}\r\n:{}\r\n", ::bulk(n.first),
+                         n.second.ops, n.second.bytes);
+    }
+    return r;
+}
@@ -0,0 +1,68 @@
+#ifndef __CERBERUS_SLOT_STATS_HPP__
+#define __CERBERUS_SLOT_STATS_HPP__
+
+#include <atomic>
+#include <string>
+
+#include "common.hpp"
+
+namespace cerb {
+
+    class Proxy;
+
+    /*
+     * Operations and bytes (request and reply) of each slot seen by one
+     * thread. Written by the owner thread only; the counters of a slot share
+     * a cache line, and other threads read them relaxed when merging.
+     */
+    class SlotStats {
+        struct Counter {
+            std::atomic<uint64_t> ops;
+            std::atomic<uint64_t> bytes;
+        };
+
+        Counter _slots[CLUSTER_SLOT_COUNT];
+
+        static void _incr(std::atomic<uint64_t>& a, uint64_t n)
+        {
+            a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    public:
+        SlotStats()
+        {
+            for (Counter& c: this->_slots) {
+                c.ops.store(0, std::memory_order_relaxed);
+                c.bytes.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        SlotStats(SlotStats const&) = delete;
+
+        void record(slot s, uint64_t bytes)
+        {
+            Counter& c = this->_slots[s];
+            _incr(c.ops, 1);
+            _incr(c.bytes, bytes);
+        }
+
+        uint64_t ops(slot s) const
+        {
+            return this->_slots[s].ops.load(std::memory_order_relaxed);
+        }
+
+        uint64_t bytes(slot s) const
+        {
+            return this->_slots[s].bytes.load(std::memory_order_relaxed);
+        }
+    };
+
+    /*
+     * Reply of PROXY SLOTSTATS: the top hottest slots by operations of all
+     * threads, with the nodes serving them in the slot map of proxy,
+     * followed by the totals of each node
+     */
+    std::string slot_stats_report(Proxy* proxy, msize_t top);
+
+}
+
+#endif /* __CERBERUS_SLOT_STATS_HPP__ */
@@ -0,0 +1,190 @@
+#include <atomic>
+#include <ctime>
+#include <algorithm>
+#include <cppformat/format.h>
+
+#include "slowlog.hpp"
+#include "command.hpp"
+#include "client.hpp"
+#include "message.hpp"
+#include "globals.hpp"
+#include "fdutil.hpp"
+#include "utils/address.hpp"
+#include "utils/string.h"
+
+using namespace cerb;
+
+static std::atomic<uint64_t> next_entry_id(0);
+static std::atomic<uint64_t> reset_entry_id(0);
+
+namespace {
+
+    class ArgsCollector
+        : public msg::MessageSplitterBase<Buffer::iterator, ArgsCollector>
+    {
+        typedef msg::MessageSplitterBase<Buffer::iterator, ArgsCollector> BaseType;
+
+        int _argc_total;
+        char* _out;
+        char* const _out_end;
+    public:
+        int argc;
+
+        ArgsCollector(Buffer::iterator i, char* out, char* out_end)
+            : BaseType(i)
+            , _argc_total(0)
+            , _out(out)
+            , _out_end(out_end)
+            , argc(0)
+        {}
+
+        ArgsCollector(ArgsCollector&& rhs)
+            : BaseType(std::move(rhs))
+            , _argc_total(rhs._argc_total)
+            , _out(rhs._out)
+            , _out_end(rhs._out_end)
+            , argc(rhs.argc)
+        {}
+
+        void on_array(cerb::rint size)
+        {
+            this->_argc_total = size;
+        }
+
+        void append(std::string const& s)
+        {
+            msize_t len = std::min(s.size(), msize_t(255));
+            if (this->_out + len + 1 > this->_out_end) {
+                return;
+            }
+            *this->_out++ = char(len);
+            std::copy(s.begin(), s.begin() + len, this->_out);
+            this->_out += len;
+            ++this->argc;
+        }
+
+        void on_string(Buffer::iterator begin, Buffer::iterator end)
+        {
+            if (this->argc == SlowLogEntry::MAX_ARGC) {
+                return;
+            }
+            if (this->argc == SlowLogEntry::MAX_ARGC - 1 &&
+                this->_argc_total > SlowLogEntry::MAX_ARGC)
+            {
+                return this->append(fmt::format("... ({} more arguments)",
+                                                this->_argc_total - this->argc));
+            }
+            msize_t len = end - begin;
+            if (len > msize_t(SlowLogEntry::MAX_ARG_LEN)) {
+                return this->append(
+                    std::string(begin, begin + SlowLogEntry::MAX_ARG_LEN) +
+                    fmt::format("... ({} more bytes)", len - SlowLogEntry::MAX_ARG_LEN));
+            }
+            this->append(std::string(begin, end));
+        }
+    };
+
+    void copy_cstr(std::string const& s, char* dst, msize_t size)
+    {
+        msize_t len = std::min(s.size(), size - 1);
+        std::copy(s.begin(), s.begin() + len, dst);
+        dst[len] = '\0';
+    }
+
+    std::string format_entry(SlowLogEntry const& e)
+    {
+        std::string args;
+        char const* p = e.args;
+        for (int i = 0; i < e.argc; ++i) {
+            msize_t len = byte(*p++);
+            args += fmt::format("${}\r\n", len);
+            args.append(p, len);
+            args += "\r\n";
+            p += len;
+        }
+        std::string client(e.client);
+        std::string node(e.node);
+        return fmt::format(
+            "*8\r\n:{}\r\n:{}\r\n:{}\r\n*{}\r\n{}${}\r\n{}\r\n${}\r\n{}\r\n:{}\r\n:{}\r\n",
+            e.id, e.timestamp, e.proxy_us, e.argc, args, client.size(), client,
+            node.size(), node, e.key_slot, e.remote_us);
+    }
+
+    template <typename F>
+    void for_each_entry(F f)
+    {
+        uint64_t reset_id = ::reset_entry_id.load(std::memory_order_acquire);
+        for (auto const& t: cerb_global::all_threads) {
+            t.get_proxy()->slow_log.for_each(
+                [&](SlowLogEntry const& e)
+                {
+                    if (e.id < reset_id) {
+                        return false;
+                    }
+                    f(e);
+                    return true;
+                });
+        }
+    }
+
+}
+
+int cerb::pack_args(Buffer::iterator begin, Buffer::iterator end, char* out, msize_t size)
+{
+    return msg::split_by(begin, end, ArgsCollector(begin, out, out + size)).argc;
+}
+
+bool SlowLog::slow(Interval elapse)
+{
+    return Interval(0) <= cerb_global::slowlog_slower_than &&
+        cerb_global::slowlog_slower_than <= elapse;
+}
+
+void SlowLog::record(util::sref<DataCommand> cmd, util::Address const& node, Time now)
+{
+    SlowLogEntry e;
+    e.id = ::next_entry_id.fetch_add(1, std::memory_order_relaxed);
+    e.timestamp = std::time(nullptr);
+    e.proxy_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - cmd->group->creation).count();
+    e.remote_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - cmd->sent_time).count();
+    e.key_slot = cmd->key_slot();
+    e.argc = pack_args(cmd->buffer->begin(), cmd->buffer->end(),
+                       e.args, SlowLogEntry::ARGS_SIZE);
+    ::copy_cstr(node.str(), e.node, SlowLogEntry::ADDR_SIZE);
+    ::copy_cstr(peer_address(cmd->group->client->fd), e.client, SlowLogEntry::ADDR_SIZE);
+    this->_entries.push(e);
+}
+
+std::string cerb::slowlog_get(msize_t count)
+{
+    std::vector<SlowLogEntry> entries;
+    ::for_each_entry([&](SlowLogEntry const& e) { entries.push_back(e); });
+    std::sort(entries.begin(), entries.end(),
+              [](SlowLogEntry const& a, SlowLogEntry const& b)
+              {
+                  return a.id > b.id;
+              });
+    if (entries.size() > count) {
+        entries.resize(count);
+    }
+    std::string r(fmt::format("*{}\r\n", entries.size()));
+    for (SlowLogEntry const& e: entries) {
+        r += ::format_entry(e);
+    }
+    return r;
+}
+
+msize_t cerb::slowlog_len()
+{
+    msize_t n = 0;
+    ::for_each_entry([&](SlowLogEntry const&) { ++n; });
+    return n;
+}
+
+void cerb::slowlog_reset()
+{
+    ::reset_entry_id.store(::next_entry_id.load(std::memory_order_relaxed),
+                           std::memory_order_release);
+}
@@ -0,0 +1,71 @@
+#ifndef __CERBERUS_SLOW_LOG_HPP__
+#define __CERBERUS_SLOW_LOG_HPP__
+
+#include <string>
+
+#include "common.hpp"
+#include "buffer.hpp"
+#include "utils/pointer.h"
+#include "utils/seq_ring.hpp"
+
+namespace util {
+
+    struct Address;
+
+}
+
+namespace cerb {
+
+    class DataCommand;
+
+    struct SlowLogEntry {
+        static int const MAX_ARGC = 16;
+        static int const MAX_ARG_LEN = 64;
+        static int const ARGS_SIZE = 640;
+        static int const ADDR_SIZE = 48;
+
+        uint64_t id;
+        int64_t timestamp;
+        int64_t proxy_us;
+        int64_t remote_us;
+        slot key_slot;
+        int argc;
+        char args[ARGS_SIZE];
+        char node[ADDR_SIZE];
+        char client[ADDR_SIZE];
+    };
+
+    /*
+     * Pack at most SlowLogEntry::MAX_ARGC arguments of the command in [begin, end)
+     * into out, each as a length byte followed by at most MAX_ARG_LEN bytes;
+     * returns the number of arguments packed
+     */
+    int pack_args(Buffer::iterator begin, Buffer::iterator end, char* out, msize_t size);
+
+    class SlowLog {
+        util::SeqRing<SlowLogEntry> _entries;
+    public:
+        explicit SlowLog(msize_t max_len)
+            : _entries(max_len)
+        {}
+
+        SlowLog(SlowLog const&) = delete;
+
+        static bool slow(Interval elapse);
+
+        void record(util::sref<DataCommand> cmd, util::Address const& node, Time now);
+
+        template <typename F>
+        void for_each(F f) const
+        {
+            this->_entries.for_each(f);
+        }
+    };
+
+    std::string slowlog_get(msize_t count);
+    msize_t slowlog_len();
+    void slowlog_reset();
+
+}
+
+#endif /* __CERBERUS_SLOW_LOG_HPP__ */
@@ -1,4 +1,5 @@
 #include <sys/resource.h>
+#include <cppformat/format.h>
 
 #include "stats.hpp"
 #include "globals.hpp"
@@ -8,6 +9,123 @@ using namespace cerb;
 
 static bool read_slave = false;
 
+namespace {
+
+    class MetricsWriter {
+        std::string _out;
+    public:
+        void family(std::string const& name, std::string const& type,
+                    std::string const& help)
+        {
+            _out += fmt::format("# TYPE {} {}\n# HELP {} {}\n", name, type, name, help);
+        }
+
+        void sample(std::string const& name, std::string const& labels,
+                    std::string const& value)
+        {
+            if (labels.empty()) {
+                _out += fmt::format("{} {}\n", name, value);
+            } else {
+                _out += fmt::format("{}{{{}}} {}\n", name, labels, value);
+            }
+        }
+
+        void per_thread(std::string const& name, std::vector<StatsSnapshot> const& stats,
+                        StatField field, double scale=1)
+        {
+            for (msize_t i = 0; i < stats.size(); ++i) {
+                this->sample(name, fmt::format("thread=\"{}\"", i),
+                             scale == 1 ? util::str(stats[i][field])
+                                        : util::str(stats[i][field] * scale));
+            }
+        }
+
+        template <typename F>
+        void histogram(std::string const& name, std::string const& help, F f)
+        {
+            this->family(name, "histogram", help);
+            for (msize_t t = 0; t < cerb_global::all_threads.size(); ++t) {
+                util::Histogram::Counts c;
+                ThreadStats const* stats = cerb_global::all_threads[t].stats();
+                if (stats != nullptr) {
+                    f(*stats).add_to(c);
+                }
+                std::string thread_label(fmt::format("thread=\"{}\"", t));
+                uint64_t cumulative = 0;
+                for (int i = 0; i < util::Histogram::BUCKETS; ++i) {
+                    cumulative += c.buckets[i];
+                    std::string le(i == util::Histogram::BUCKETS - 1
+                                   ? "+Inf"
+                                   : util::str(util::Histogram::upper_bound_us(i) / 1e6));
+                    this->sample(name + "_bucket",
+                                 fmt::format("{},le=\"{}\"", thread_label, le),
+                                 util::str(msize_t(cumulative)));
+                }
+                this->sample(name + "_count", thread_label, util::str(msize_t(cumulative)));
+                this->sample(name + "_sum", thread_label, util::str(c.sum_us / 1e6));
+            }
+        }
+
+        std::string finish()
+        {
+            _out += "# EOF\n";
+            return std::move(_out);
+        }
+    };
+
+    double seconds(struct timeval const& t)
+    {
+        return t.tv_sec + t.tv_usec / 1000000.0;
+    }
+
+    struct LoopCounter {
+        StatField field;
+        char const* name;
+        char const* help;
+        double scale;
+    };
+
+    LoopCounter const LOOP_COUNTERS[] = {
+        {STAT_LOOP_ITERATIONS, "cerberus_loop_iterations", "Event loop iterations", 1},
+        {STAT_POLLED_EVENTS, "cerberus_polled_events", "Events returned by epoll_wait", 1},
+        {STAT_ON_EVENTS_NS, "cerberus_on_events_seconds",
+         "Time spent handling polled events", 1e-9},
+        {STAT_AFTER_EVENTS_NS, "cerberus_after_events_seconds",
+         "Time spent in after events procedures", 1e-9},
+        {STAT_SLOT_MAP_NS, "cerberus_slot_map_seconds",
+         "Time spent retrieving and applying slot maps", 1e-9},
+        {STAT_READ_CALLS, "cerberus_read_calls", "Calls of read", 1},
+        {STAT_READ_BYTES, "cerberus_read_bytes", "Bytes read", 1},
+        {STAT_WRITE_CALLS, "cerberus_write_calls", "Calls of write", 1},
+        {STAT_WRITE_BYTES, "cerberus_write_bytes", "Bytes written by write", 1},
+        {STAT_WRITEV_CALLS, "cerberus_writev_calls", "Calls of writev", 1},
+        {STAT_WRITEV_BYTES, "cerberus_writev_bytes", "Bytes written by writev", 1},
+        {STAT_EPOLL_CTL_CALLS, "cerberus_epoll_ctl_calls", "Calls of epoll_ctl", 1},
+        {STAT_CPU_USER_US, "cerberus_thread_cpu_user_seconds",
+         "User CPU time of the thread, sampled every 100ms", 1e-6},
+        {STAT_CPU_SYS_US, "cerberus_thread_cpu_system_seconds",
+         "System CPU time of the thread, sampled every 100ms", 1e-6},
+    };
+
+}
+
+static std::string per_thread_fields(StatField first, StatField last)
+{
+    std::vector<StatsSnapshot> stats;
+    for (auto const& thread: cerb_global::all_threads) {
+        stats.push_back(thread.stats_snapshot());
+    }
+    std::string r;
+    for (int f = first; f < last; ++f) {
+        std::vector<std::string> values;
+        for (StatsSnapshot const& s: stats) {
+            values.push_back(util::str(s[StatField(f)]));
+        }
+        r += fmt::format("\n{}:{}", stat_field_name(StatField(f)), util::join(",", values));
+    }
+    return r;
+}
+
 std::string cerb::stats_all()
 {
     struct rusage res_usage;
@@ -19,20 +137,16 @@ std::string cerb::stats_all()
     std::vector<std::string> mem_buffer_allocs;
     std::vector<std::string> last_cmd_elapse;
     std::vector<std::string> last_remote_cost;
-    long total_commands = 0;
-    Interval total_cmd_elapse(0);
-    Interval total_remote_cost(0);
+    StatsSnapshot total;
     for (auto const& thread: cerb_global::all_threads) {
-        util::sref<Proxy const> proxy(thread.get_proxy());
-        clients_counts.push_back(util::str(proxy->clients_count()));
-        acceptings.push_back(proxy->accepting() ? "1" : "0");
-        long_conns_counts.push_back(util::str(proxy->long_conns_count()));
-        total_commands += proxy->total_cmd();
-        total_cmd_elapse += proxy->total_cmd_elapse();
-        total_remote_cost += proxy->total_remote_cost();
-        mem_buffer_allocs.push_back(util::str(thread.buffer_allocated()));
-        last_cmd_elapse.push_back(util::str(proxy->last_cmd_elapse()));
-        last_remote_cost.push_back(util::str(proxy->last_remote_cost()));
+        StatsSnapshot s(thread.stats_snapshot());
+        clients_counts.push_back(util::str(s[STAT_CLIENTS]));
+        acceptings.push_back(s[STAT_ACCEPTING] ? "1" : "0");
+        long_conns_counts.push_back(util::str(s[STAT_LONG_CONNECTIONS]));
+        mem_buffer_allocs.push_back(util::str(s[STAT_BUFFER_ALLOCATED]));
+        last_cmd_elapse.push_back(util::str(stat_interval(s[STAT_LAST_CMD_ELAPSE_NS])));
+        last_remote_cost.push_back(util::str(stat_interval(s[STAT_LAST_REMOTE_COST_NS])));
+        total += s;
     }
     std::vector<std::string> remotes_addrs;
     for (util::Address const& a: cerb_global::get_remotes()) {
@@ -51,15 +165,134 @@ std::string cerb::stats_all()
         "\nused_cpu_user:", util::str(res_usage.ru_utime.tv_sec +
                                       res_usage.ru_utime.tv_usec / 1000000.0),
         "\nmem_buffer_alloc:", util::join(",", mem_buffer_allocs),
-        "\ncompleted_commands:", util::str(total_commands),
-        "\ntotal_process_elapse:", util::str(total_cmd_elapse),
-        "\ntotal_remote_cost:", util::str(total_remote_cost),
+        "\ncompleted_commands:", util::str(total[STAT_COMPLETED_COMMANDS]),
+        "\ntotal_process_elapse:", util::str(stat_interval(total[STAT_CMD_ELAPSE_NS])),
+        "\ntotal_remote_cost:", util::str(stat_interval(total[STAT_REMOTE_COST_NS])),
         "\nlast_command_elapse:", util::join(",", last_cmd_elapse),
         "\nlast_remote_cost:", util::join(",", last_remote_cost),
         "\nremotes:", util::join(",", remotes_addrs),
+        "\ncompression_ratio:", total[STAT_COMPRESS_OUTPUT_BYTES] == 0 ? "0" : util::str(
+            double(total[STAT_COMPRESS_INPUT_BYTES]) / total[STAT_COMPRESS_OUTPUT_BYTES]),
+        ::per_thread_fields(STAT_LOOP_ITERATIONS, STAT_FIELDS_COUNT),
     });
 }
 
+std::string cerb::stats_openmetrics()
+{
+    struct rusage res_usage;
+    getrusage(RUSAGE_SELF, &res_usage);
+
+    MetricsWriter w;
+    w.family("cerberus_build", "info", "Proxy version");
+    w.sample("cerberus_build_info", "version=\"" VERSION "\"", "1");
+    w.family("cerberus_threads", "gauge", "Number of proxy threads");
+    w.sample("cerberus_threads", "", util::str(msize_t(cerb_global::all_threads.size())));
+    w.family("cerberus_cluster_ok", "gauge", "Whether the slot map covers the cluster");
+    w.sample("cerberus_cluster_ok", "", cerb_global::cluster_ok() ? "1" : "0");
+    w.family("cerberus_read_slave", "gauge", "Whether the proxy reads from slaves");
+    w.sample("cerberus_read_slave", "", ::read_slave ? "1" : "0");
+    w.family("cerberus_cpu_seconds", "counter", "CPU time consumed by the process");
+    w.sample("cerberus_cpu_seconds_total", "mode=\"system\"",
+             util::str(::seconds(res_usage.ru_stime)));
+    w.sample("cerberus_cpu_seconds_total", "mode=\"user\"",
+             util::str(::seconds(res_usage.ru_utime)));
+
+    std::vector<StatsSnapshot> stats;
+    for (auto const& thread: cerb_global::all_threads) {
+        stats.push_back(thread.stats_snapshot());
+    }
+    w.family("cerberus_clients", "gauge", "Connected clients");
+    w.per_thread("cerberus_clients", stats, STAT_CLIENTS);
+    w.family("cerberus_long_connections", "gauge", "Clients in blocking or subscribing state");
+    w.per_thread("cerberus_long_connections", stats, STAT_LONG_CONNECTIONS);
+    w.family("cerberus_accepting", "gauge", "Whether the thread accepts new clients");
+    w.per_thread("cerberus_accepting", stats, STAT_ACCEPTING);
+    w.family("cerberus_buffer_allocated_bytes", "gauge", "Memory allocated for buffers");
+    w.per_thread("cerberus_buffer_allocated_bytes", stats, STAT_BUFFER_ALLOCATED);
+    w.family("cerberus_commands", "counter", "Completed commands");
+    w.per_thread("cerberus_commands_total", stats, STAT_COMPLETED_COMMANDS);
+    w.family("cerberus_monitor_dropped", "counter",
+             "Commands not passed to monitors because their rings are full");
+    w.per_thread("cerberus_monitor_dropped_total", stats, STAT_MONITOR_DROPPED);
+    w.family("cerberus_noreply_commands", "counter",
+             "Commands of no-reply clients written without awaiting replies");
+    w.per_thread("cerberus_noreply_commands_total", stats, STAT_NOREPLY_COMMANDS);
+    w.family("cerberus_noreply_dropped", "counter",
+             "Commands of no-reply clients dropped as their connections to nodes are closed");
+    w.per_thread("cerberus_noreply_dropped_total", stats, STAT_NOREPLY_DROPPED);
+    w.family("cerberus_coalesced_increments", "counter", "Increments buffered to coalesce");
+    w.per_thread("cerberus_coalesced_increments_total", stats, STAT_COALESCED_INCREMENTS);
+    w.family("cerberus_coalesced_flushes", "counter",
+             "Summed increments sent to nodes for coalesced ones");
+    w.per_thread("cerberus_coalesced_flushes_total", stats, STAT_COALESCED_FLUSHES);
+    w.family("cerberus_compressed_values", "counter", "Values stored compressed");
+    w.per_thread("cerberus_compressed_values_total", stats, STAT_COMPRESSED_VALUES);
+    w.family("cerberus_compress_input_bytes", "counter",
+             "Bytes of values of compress-prefixes keys large enough to compress");
+    w.per_thread("cerberus_compress_input_bytes_total", stats, STAT_COMPRESS_INPUT_BYTES);
+    w.family("cerberus_compress_output_bytes", "counter",
+             "Bytes of those values as sent to nodes, compressed or not");
+    w.per_thread("cerberus_compress_output_bytes_total", stats, STAT_COMPRESS_OUTPUT_BYTES);
+    w.family("cerberus_compress_seconds", "counter", "Time spent compressing values");
+    w.per_thread("cerberus_compress_seconds_total", stats, STAT_COMPRESS_NS, 1e-9);
+    w.family("cerberus_decompressed_values", "counter", "Compressed values decoded in replies");
+    w.per_thread("cerberus_decompressed_values_total", stats, STAT_DECOMPRESSED_VALUES);
+    w.family("cerberus_decompress_seconds", "counter", "Time spent decompressing values");
+    w.per_thread("cerberus_decompress_seconds_total", stats, STAT_DECOMPRESS_NS, 1e-9);
+    w.family("cerberus_streamed_replies", "counter",
+             "Replies passed on to clients as they arrive");
+    w.per_thread("cerberus_streamed_replies_total", stats, STAT_STREAMED_REPLIES);
+    w.family("cerberus_streamed_bytes", "counter", "Bytes of streamed replies");
+    w.per_thread("cerberus_streamed_bytes_total", stats, STAT_STREAMED_BYTES);
+    w.family("cerberus_streamed_requests", "counter",
+             "Requests passed on to nodes as they arrive");
+    w.per_thread("cerberus_streamed_requests_total", stats, STAT_STREAMED_REQUESTS);
+    w.family("cerberus_streamed_request_bytes", "counter", "Bytes of streamed requests");
+    w.per_thread("cerberus_streamed_request_bytes_total", stats, STAT_STREAMED_REQUEST_BYTES);
+    w.family("cerberus_request_args_rejected", "counter",
+             "Requests over max-request-args, of which clients are closed");
+    w.per_thread("cerberus_request_args_rejected_total", stats, STAT_REQUEST_ARGS_REJECTED);
+    w.family("cerberus_fanout_rejected", "counter", "Commands refused by max-fanout-keys");
+    w.per_thread("cerberus_fanout_rejected_total", stats, STAT_FANOUT_REJECTED);
+    w.family("cerberus_fanout_windowed", "counter",
+             "Multiple key commands sent in windows of fanout-window per node");
+    w.per_thread("cerberus_fanout_windowed_total", stats, STAT_FANOUT_WINDOWED);
+    w.family("cerberus_queued_commands", "gauge", "Commands of clients awaiting replies of nodes");
+    w.per_thread("cerberus_queued_commands", stats, STAT_QUEUED_COMMANDS);
+    w.family("cerberus_overloaded", "gauge", "Whether the thread sheds commands over shed-target");
+    w.per_thread("cerberus_overloaded", stats, STAT_OVERLOADED);
+    w.family("cerberus_shed_commands", "counter", "Commands rejected as the thread is overloaded");
+    w.per_thread("cerberus_shed_commands_total", stats, STAT_SHED_COMMANDS);
+    w.family("cerberus_shed_queue_full", "counter", "Commands rejected by shed-max-queue");
+    w.per_thread("cerberus_shed_queue_full_total", stats, STAT_SHED_QUEUE_FULL);
+    w.family("cerberus_streamed_request_stalls", "counter",
+             "Clients closed as streamed requests stalled over request-stream-timeout-ms");
+    w.per_thread("cerberus_streamed_request_stalls_total", stats, STAT_STREAMED_REQUEST_STALLS);
+    for (LoopCounter const& c: LOOP_COUNTERS) {
+        w.family(c.name, "counter", c.help);
+        w.per_thread(std::string(c.name) + "_total", stats, c.field, c.scale);
+    }
+    w.histogram("cerberus_loop_duration_seconds",
+                "Time of handling events in one event loop iteration",
+                [](ThreadStats const& s) -> util::Histogram const&
+                {
+                    return s.loop_elapse_hist;
+                });
+    w.histogram("cerberus_command_duration_seconds",
+                "Time from receiving a command to responding it",
+                [](ThreadStats const& s) -> util::Histogram const&
+                {
+                    return s.cmd_elapse_hist;
+                });
+    w.histogram("cerberus_remote_duration_seconds",
+                "Time from sending a command to a remote to receiving its response",
+                [](ThreadStats const& s) -> util::Histogram const&
+                {
+                    return s.remote_cost_hist;
+                });
+    return w.finish();
+}
+
 void cerb::stats_set_read_slave()
 {
     ::read_slave = true;
@@ -68,12 +301,12 @@ void cerb::stats_set_read_slave()
 BufferStatAllocator::pointer BufferStatAllocator::allocate(
     size_type n, void const* hint)
 {
-    cerb_global::allocated_buffer += n;
+    cerb_global::thread_stats.add(STAT_BUFFER_ALLOCATED, n);
     return BaseType::allocate(n, hint);
 }
 
 void BufferStatAllocator::deallocate(pointer p, size_type n)
 {
-    cerb_global::allocated_buffer -= n;
+    cerb_global::thread_stats.add(STAT_BUFFER_ALLOCATED, -int64_t(n));
     BaseType::deallocate(p, n);
 }
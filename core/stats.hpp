@@ -1,15 +1,267 @@
 #ifndef __CERBERUS_STATISTICS_HPP__
 #define __CERBERUS_STATISTICS_HPP__
 
+#include <atomic>
+#include <thread>
 #include <string>
 
 #include "common.hpp"
+#include "utils/histogram.hpp"
 
 namespace cerb {
 
     std::string stats_all();
+    std::string stats_openmetrics();
     void stats_set_read_slave();
 
+    enum StatField {
+        STAT_CLIENTS,
+        STAT_LONG_CONNECTIONS,
+        STAT_ACCEPTING,
+        STAT_BUFFER_ALLOCATED,
+        STAT_COMPLETED_COMMANDS,
+        STAT_CMD_ELAPSE_NS,
+        STAT_REMOTE_COST_NS,
+        STAT_LAST_CMD_ELAPSE_NS,
+        STAT_LAST_REMOTE_COST_NS,
+        STAT_LOOP_ITERATIONS,
+        STAT_POLLED_EVENTS,
+        STAT_ON_EVENTS_NS,
+        STAT_AFTER_EVENTS_NS,
+        STAT_SLOT_MAP_NS,
+        STAT_READ_CALLS,
+        STAT_READ_BYTES,
+        STAT_WRITE_CALLS,
+        STAT_WRITE_BYTES,
+        STAT_WRITEV_CALLS,
+        STAT_WRITEV_BYTES,
+        STAT_EPOLL_CTL_CALLS,
+        STAT_CPU_USER_US,
+        STAT_CPU_SYS_US,
+        STAT_MONITOR_DROPPED,
+        STAT_NOREPLY_COMMANDS,
+        STAT_NOREPLY_DROPPED,
+        STAT_COALESCED_INCREMENTS,
+        STAT_COALESCED_FLUSHES,
+        STAT_COMPRESSED_VALUES,
+        STAT_COMPRESS_INPUT_BYTES,
+        STAT_COMPRESS_OUTPUT_BYTES,
+        STAT_COMPRESS_NS,
+        STAT_DECOMPRESSED_VALUES,
+        STAT_DECOMPRESS_NS,
+        STAT_STREAMED_REPLIES,
+        STAT_STREAMED_BYTES,
+        STAT_STREAMED_REQUESTS,
+        STAT_STREAMED_REQUEST_BYTES,
+        STAT_REQUEST_ARGS_REJECTED,
+        STAT_FANOUT_REJECTED,
+        STAT_FANOUT_WINDOWED,
+        STAT_QUEUED_COMMANDS,
+        STAT_OVERLOADED,
+        STAT_SHED_COMMANDS,
+        STAT_SHED_QUEUE_FULL,
+        STAT_STREAMED_REQUEST_STALLS,
+        STAT_FIELDS_COUNT,
+    };
+
+    inline char const* stat_field_name(StatField f)
+    {
+        static char const* const names[] = {
+            "clients",
+            "long_connections",
+            "accepting",
+            "buffer_allocated",
+            "completed_commands",
+            "cmd_elapse_ns",
+            "remote_cost_ns",
+            "last_cmd_elapse_ns",
+            "last_remote_cost_ns",
+            "loop_iterations",
+            "polled_events",
+            "on_events_ns",
+            "after_events_ns",
+            "slot_map_ns",
+            "read_calls",
+            "read_bytes",
+            "write_calls",
+            "write_bytes",
+            "writev_calls",
+            "writev_bytes",
+            "epoll_ctl_calls",
+            "cpu_user_us",
+            "cpu_sys_us",
+            "monitor_dropped",
+            "noreply_commands",
+            "noreply_dropped",
+            "coalesced_increments",
+            "coalesced_flushes",
+            "compressed_values",
+            "compress_input_bytes",
+            "compress_output_bytes",
+            "compress_ns",
+            "decompressed_values",
+            "decompress_ns",
+            "streamed_replies",
+            "streamed_bytes",
+            "streamed_requests",
+            "streamed_request_bytes",
+            "request_args_rejected",
+            "fanout_rejected",
+            "fanout_windowed",
+            "queued_commands",
+            "overloaded",
+            "shed_commands",
+            "shed_queue_full",
+            "streamed_request_stalls",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == STAT_FIELDS_COUNT,
+                      "every stat field shall be named");
+        return names[f];
+    }
+
+    inline int64_t stat_ns(Interval i)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(i).count();
+    }
+
+    inline Interval stat_interval(int64_t ns)
+    {
+        return Interval(ns / 1e9);
+    }
+
+    inline int64_t stat_ns_since(Time start)
+    {
+        return stat_ns(Clock::now() - start);
+    }
+
+    struct StatsSnapshot {
+        int64_t values[STAT_FIELDS_COUNT];
+
+        StatsSnapshot()
+        {
+            for (int i = 0; i < STAT_FIELDS_COUNT; ++i) {
+                values[i] = 0;
+            }
+        }
+
+        int64_t operator[](StatField f) const
+        {
+            return values[f];
+        }
+
+        StatsSnapshot& operator+=(StatsSnapshot const& rhs)
+        {
+            for (int i = 0; i < STAT_FIELDS_COUNT; ++i) {
+                values[i] += rhs.values[i];
+            }
+            return *this;
+        }
+    };
+
+    /*
+     * Statistics of one proxy thread, padded to cache lines so that threads
+     * never share a line. Only the owner thread writes; each write is wrapped
+     * in a sequence lock so other threads take consistent snapshots without
+     * ever blocking the owner.
+     */
+    class alignas(64) ThreadStats {
+        std::atomic<uint64_t> _seq;
+        std::atomic<int64_t> _values[STAT_FIELDS_COUNT];
+    public:
+        class Writer {
+            std::atomic<int64_t>* const _values;
+        public:
+            explicit Writer(std::atomic<int64_t>* values)
+                : _values(values)
+            {}
+
+            void set(StatField f, int64_t v)
+            {
+                _values[f].store(v, std::memory_order_relaxed);
+            }
+
+            void add(StatField f, int64_t n)
+            {
+                this->set(f, _values[f].load(std::memory_order_relaxed) + n);
+            }
+        };
+
+        /* recorded by the owner only; not covered by the sequence lock */
+        util::Histogram cmd_elapse_hist;
+        util::Histogram remote_cost_hist;
+        util::Histogram loop_elapse_hist;
+
+        ThreadStats()
+            : _seq(0)
+        {
+            for (int i = 0; i < STAT_FIELDS_COUNT; ++i) {
+                _values[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        ThreadStats(ThreadStats const&) = delete;
+
+        /* owner thread only */
+        int64_t get(StatField f) const
+        {
+            return _values[f].load(std::memory_order_relaxed);
+        }
+
+        /* owner thread only; f(Writer&) updates several fields at once */
+        template <typename F>
+        void update(F f)
+        {
+            uint64_t seq = _seq.load(std::memory_order_relaxed);
+            _seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            Writer w(_values);
+            f(w);
+            _seq.store(seq + 2, std::memory_order_release);
+        }
+
+        void set(StatField f, int64_t v)
+        {
+            this->update([&](Writer& w) { w.set(f, v); });
+        }
+
+        void add(StatField f, int64_t n)
+        {
+            this->update([&](Writer& w) { w.add(f, n); });
+        }
+
+        /* count one IO call and the bytes it transferred, if any */
+        void io_call(StatField calls, StatField bytes, ssize_t n)
+        {
+            this->update(
+                [&](Writer& w)
+                {
+                    w.add(calls, 1);
+                    if (n > 0) {
+                        w.add(bytes, n);
+                    }
+                });
+        }
+
+        /* any thread */
+        StatsSnapshot snapshot() const
+        {
+            StatsSnapshot s;
+            while (true) {
+                uint64_t seq = _seq.load(std::memory_order_acquire);
+                if (seq % 2 == 0) {
+                    for (int i = 0; i < STAT_FIELDS_COUNT; ++i) {
+                        s.values[i] = _values[i].load(std::memory_order_relaxed);
+                    }
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (seq == _seq.load(std::memory_order_relaxed)) {
+                        return s;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+    };
+
     class BufferStatAllocator
         : public std::allocator<byte>
     {
@@ -0,0 +1,140 @@
+#include <atomic>
+#include <algorithm>
+#include <cppformat/format.h>
+
+#include "trace.hpp"
+#include "globals.hpp"
+#include "utils/string.h"
+
+using namespace cerb;
+
+static std::atomic<uint64_t> next_record_id(0);
+static thread_local msize_t commands_since_sample(0);
+
+char const* cerb::trace_stage_name(TraceStage s)
+{
+    static char const* const names[] = {
+        "read",
+        "parse",
+        "server_queue",
+        "server_write",
+        "backend_reply",
+        "client_queue",
+        "client_write",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == TRACE_STAGES_COUNT,
+                  "every trace stage shall be named");
+    return names[s];
+}
+
+CommandTrace::CommandTrace(std::string cmd, Time read, Time parsed)
+    : command(std::move(cmd))
+{
+    std::fill(this->_reached, this->_reached + TRACE_STAGES_COUNT, false);
+    this->_stages[TRACE_READ] = read;
+    this->_reached[TRACE_READ] = true;
+    this->_stages[TRACE_PARSED] = parsed;
+    this->_reached[TRACE_PARSED] = true;
+}
+
+void CommandTrace::stage(TraceStage s)
+{
+    this->_stages[s] = Clock::now();
+    this->_reached[s] = true;
+}
+
+bool Tracer::sample()
+{
+    if (cerb_global::trace_sample_rate == 0) {
+        return false;
+    }
+    if (++::commands_since_sample < cerb_global::trace_sample_rate) {
+        return false;
+    }
+    ::commands_since_sample = 0;
+    return true;
+}
+
+void Tracer::record(util::sref<CommandTrace const> trace)
+{
+    TraceRecord r;
+    r.id = ::next_record_id.fetch_add(1, std::memory_order_relaxed);
+    Time begin = trace->at(TRACE_READ);
+    r.begin_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        begin.time_since_epoch()).count();
+    for (int s = 0; s < TRACE_STAGES_COUNT; ++s) {
+        r.stage_ns[s] = trace->reached(TraceStage(s))
+            ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                trace->at(TraceStage(s)) - begin).count()
+            : -1;
+    }
+    msize_t len = std::min(trace->command.size(), msize_t(TraceRecord::COMMAND_SIZE - 1));
+    std::copy(trace->command.begin(), trace->command.begin() + len, r.command);
+    r.command[len] = '\0';
+    this->_records.push(r);
+}
+
+static std::string json_escape(std::string const& s)
+{
+    std::string r;
+    for (char c: s) {
+        if (c == '"' || c == '\\') {
+            r += '\\';
+            r += c;
+        } else if (0 <= c && c < 0x20) {
+            r += fmt::format("\\u{:04x}", int(c));
+        } else {
+            r += c;
+        }
+    }
+    return r;
+}
+
+static void append_events(std::vector<std::string>& events, TraceRecord const& r,
+                          msize_t thread)
+{
+    std::string name(::json_escape(r.command));
+    int last = TRACE_READ;
+    for (int s = TRACE_PARSED; s < TRACE_STAGES_COUNT; ++s) {
+        if (r.stage_ns[s] < 0) {
+            continue;
+        }
+        events.push_back(fmt::format(
+            "{{\"name\":\"{}\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":{:.3f},"
+            "\"dur\":{:.3f},\"pid\":{},\"tid\":{}}}",
+            trace_stage_name(TraceStage(s)), r.begin_us + r.stage_ns[last] / 1000.0,
+            (r.stage_ns[s] - r.stage_ns[last]) / 1000.0, thread, r.id));
+        last = s;
+    }
+    events.push_back(fmt::format(
+        "{{\"name\":\"{}\",\"cat\":\"command\",\"ph\":\"X\",\"ts\":{},"
+        "\"dur\":{:.3f},\"pid\":{},\"tid\":{}}}",
+        name, r.begin_us, r.stage_ns[last] / 1000.0, thread, r.id));
+}
+
+std::string cerb::trace_chrome_json(msize_t count)
+{
+    std::vector<std::pair<TraceRecord, msize_t>> records;
+    for (msize_t i = 0; i < cerb_global::all_threads.size(); ++i) {
+        cerb_global::all_threads[i].get_proxy()->tracer.for_each(
+            [&](TraceRecord const& r)
+            {
+                records.push_back(std::make_pair(r, i));
+                return true;
+            });
+    }
+    std::sort(records.begin(), records.end(),
+              [](std::pair<TraceRecord, msize_t> const& a,
+                 std::pair<TraceRecord, msize_t> const& b)
+              {
+                  return a.first.id > b.first.id;
+              });
+    if (records.size() > count) {
+        records.resize(count);
+    }
+    std::vector<std::string> events;
+    for (auto const& r: records) {
+        ::append_events(events, r.first, r.second);
+    }
+    return "{\"traceEvents\":[" + util::join(",", events) + "]}";
+}
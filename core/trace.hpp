@@ -0,0 +1,87 @@
+#ifndef __CERBERUS_TRACE_HPP__
+#define __CERBERUS_TRACE_HPP__
+
+#include <string>
+
+#include "common.hpp"
+#include "utils/pointer.h"
+#include "utils/seq_ring.hpp"
+
+namespace cerb {
+
+    enum TraceStage {
+        TRACE_READ,
+        TRACE_PARSED,
+        TRACE_SERVER_QUEUED,
+        TRACE_SERVER_WRITTEN,
+        TRACE_REPLY_RECEIVED,
+        TRACE_CLIENT_QUEUED,
+        TRACE_CLIENT_WRITTEN,
+        TRACE_STAGES_COUNT,
+    };
+
+    char const* trace_stage_name(TraceStage s);
+
+    /*
+     * Stage timestamps of a sampled command group. For groups of several
+     * remote commands, each stage keeps the time the last command reached it
+     */
+    class CommandTrace {
+        Time _stages[TRACE_STAGES_COUNT];
+        bool _reached[TRACE_STAGES_COUNT];
+    public:
+        std::string const command;
+
+        CommandTrace(std::string cmd, Time read, Time parsed);
+        CommandTrace(CommandTrace const&) = delete;
+
+        void stage(TraceStage s);
+
+        bool reached(TraceStage s) const
+        {
+            return this->_reached[s];
+        }
+
+        Time at(TraceStage s) const
+        {
+            return this->_stages[s];
+        }
+    };
+
+    struct TraceRecord {
+        static int const COMMAND_SIZE = 24;
+
+        uint64_t id;
+        int64_t begin_us;
+        /* since TRACE_READ; -1 if the stage is not reached */
+        int64_t stage_ns[TRACE_STAGES_COUNT];
+        char command[COMMAND_SIZE];
+    };
+
+    class Tracer {
+        util::SeqRing<TraceRecord> _records;
+    public:
+        explicit Tracer(msize_t max_len)
+            : _records(max_len)
+        {}
+
+        Tracer(Tracer const&) = delete;
+
+        /* whether the next command on this thread shall be traced */
+        static bool sample();
+
+        void record(util::sref<CommandTrace const> trace);
+
+        template <typename F>
+        void for_each(F f) const
+        {
+            this->_records.for_each(f);
+        }
+    };
+
+    /* Chrome trace event JSON of at most count newest records of all threads */
+    std::string trace_chrome_json(msize_t count);
+
+}
+
+#endif /* __CERBERUS_TRACE_HPP__ */
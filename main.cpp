@@ -9,6 +9,8 @@
 #include "core/globals.hpp"
 #include "core/command.hpp"
 #include "core/server.hpp"
+#include "core/admin.hpp"
+#include "core/shm_stats.hpp"
 #include "utils/logging.hpp"
 #include "utils/address.hpp"
 #include "utils/string.h"
@@ -124,6 +126,124 @@ namespace {
         }
         cerb_global::slow_poll_elapse = std::chrono::milliseconds(slow_poll_ms);
 
+        cerb_global::slowlog_slower_than = std::chrono::microseconds(
+            util::atoi(config.get("slowlog-log-slower-than", "10000")));
+        int slowlog_max_len = util::atoi(config.get("slowlog-max-len", "128"));
+        if (slowlog_max_len <= 0) {
+            LOG(ERROR) << "Invalid slow log max length";
+            exit(1);
+        }
+        cerb_global::slowlog_max_len = slowlog_max_len;
+
+        int trace_sample_rate = util::atoi(config.get("trace-sample-rate", "0"));
+        if (trace_sample_rate < 0) {
+            LOG(ERROR) << "Invalid trace sample rate";
+            exit(1);
+        }
+        cerb_global::trace_sample_rate = trace_sample_rate;
+        int trace_max_len = util::atoi(config.get("trace-max-len", "1024"));
+        if (trace_max_len <= 0) {
+            LOG(ERROR) << "Invalid trace max length";
+            exit(1);
+        }
+        cerb_global::trace_max_len = trace_max_len;
+
+        int scatter_max_bytes = util::atoi(config.get("scatter-max-bytes", "67108864"));
+        if (scatter_max_bytes <= 0) {
+            LOG(ERROR) << "Invalid scatter max bytes";
+            exit(1);
+        }
+        cerb_global::scatter_max_bytes = scatter_max_bytes;
+        int reply_stream_window = util::atoi(config.get("reply-stream-window", "1048576"));
+        if (reply_stream_window < 0) {
+            LOG(ERROR) << "Invalid reply stream window";
+            exit(1);
+        }
+        cerb_global::reply_stream_window = reply_stream_window;
+        int request_stream_window = util::atoi(config.get("request-stream-window", "0"));
+        int request_stream_timeout_ms = util::atoi(
+            config.get("request-stream-timeout-ms", "5000"));
+        if (request_stream_window < 0 || request_stream_timeout_ms <= 0) {
+            LOG(ERROR) << "Invalid request stream window or timeout";
+            exit(1);
+        }
+        cerb_global::request_stream_window = request_stream_window;
+        cerb_global::request_stream_timeout = std::chrono::milliseconds(
+            request_stream_timeout_ms);
+        int noreply_max_pending_bytes = util::atoi(
+            config.get("noreply-max-pending-bytes", "67108864"));
+        if (noreply_max_pending_bytes <= 0) {
+            LOG(ERROR) << "Invalid noreply max pending bytes";
+            exit(1);
+        }
+        cerb_global::noreply_max_pending_bytes = noreply_max_pending_bytes;
+
+        int max_request_args = util::atoi(config.get("max-request-args", "1048576"));
+        if (max_request_args <= 0) {
+            LOG(ERROR) << "Invalid max request args";
+            exit(1);
+        }
+        cerb_global::max_request_args = max_request_args;
+        int max_fanout_keys = util::atoi(config.get("max-fanout-keys", "0"));
+        if (max_fanout_keys < 0) {
+            LOG(ERROR) << "Invalid max fanout keys";
+            exit(1);
+        }
+        cerb_global::max_fanout_keys = max_fanout_keys;
+        int fanout_window = util::atoi(config.get("fanout-window", "1024"));
+        if (fanout_window < 0) {
+            LOG(ERROR) << "Invalid fanout window";
+            exit(1);
+        }
+        cerb_global::fanout_window = fanout_window;
+
+        int shed_target_ms = util::atoi(config.get("shed-target-ms", "0"));
+        int shed_interval_ms = util::atoi(config.get("shed-interval-ms", "100"));
+        int shed_max_queue = util::atoi(config.get("shed-max-queue", "0"));
+        if (shed_target_ms < 0 || shed_interval_ms <= 0 || shed_max_queue < 0) {
+            LOG(ERROR) << "Invalid shed target, interval or max queue";
+            exit(1);
+        }
+        cerb_global::shed_target = std::chrono::milliseconds(shed_target_ms);
+        cerb_global::shed_interval = std::chrono::milliseconds(shed_interval_ms);
+        cerb_global::shed_max_queue = shed_max_queue;
+        for (std::string c: util::split_str(
+                config.get("shed-priority-commands", ""), ",", true))
+        {
+            std::transform(c.begin(), c.end(), c.begin(), ::toupper);
+            cerb_global::shed_priority_commands.insert(c);
+        }
+
+        if (config.contains("coalesce-prefixes")) {
+            cerb_global::coalesce_prefixes = util::split_str(
+                config.get("coalesce-prefixes"), ",", true);
+            int coalesce_window_ms = util::atoi(config.get("coalesce-window-ms", "2"));
+            if (coalesce_window_ms <= 0) {
+                LOG(ERROR) << "Invalid coalesce window";
+                exit(1);
+            }
+            cerb_global::coalesce_window = std::chrono::milliseconds(coalesce_window_ms);
+            std::string reply(config.get("coalesce-reply", "deferred"));
+            if (reply != "deferred" && reply != "ack") {
+                LOG(ERROR) << "Invalid coalesce reply, shall be `deferred' or `ack'";
+                exit(1);
+            }
+            cerb_global::coalesce_ack = reply == "ack";
+            cerb::Command::coalesce_increments();
+        }
+
+        if (config.contains("compress-prefixes")) {
+            cerb_global::compress_prefixes = util::split_str(
+                config.get("compress-prefixes"), ",", true);
+            int compress_min_bytes = util::atoi(config.get("compress-min-bytes", "1024"));
+            if (compress_min_bytes <= 0) {
+                LOG(ERROR) << "Invalid compress min bytes";
+                exit(1);
+            }
+            cerb_global::compress_min_bytes = compress_min_bytes;
+            cerb::Command::compress_values();
+        }
+
         int bind_port = util::atoi(config.get("bind"));
         int thread_count = util::atoi(config.get("thread", "1"));
         if (thread_count <= 0) {
@@ -146,6 +266,30 @@ namespace {
         }
         LOG(INFO) << "Started; listen to port " << bind_port
                   << " thread=" << thread_count;
+
+        util::sptr<cerb::AdminListener> admin(nullptr);
+        if (config.contains("admin-bind")) {
+            int admin_port = util::atoi(config.get("admin-bind"));
+            if (admin_port <= 0 || admin_port == bind_port) {
+                LOG(ERROR) << "Invalid admin port";
+                exit(1);
+            }
+            admin.reset(new cerb::AdminListener(admin_port));
+            admin->run();
+        }
+
+        util::sptr<cerb::StatsPublisher> stats_publisher(nullptr);
+        if (config.contains("stats-shm")) {
+            int interval_ms = util::atoi(config.get("stats-shm-interval-ms", "1000"));
+            if (interval_ms <= 0) {
+                LOG(ERROR) << "Invalid stats shm interval";
+                exit(1);
+            }
+            stats_publisher.reset(new cerb::StatsPublisher(
+                config.get("stats-shm"), std::chrono::milliseconds(interval_ms)));
+            stats_publisher->run();
+        }
+
         for (auto& t: cerb_global::all_threads) {
             t.join();
         }
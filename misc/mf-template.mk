@@ -24,8 +24,13 @@ ifdef CANDIDATE_FCTL
 	USE_CANDIDATE_FCTL_LIB=-D_USE_CANDIDATE_FCTL_LIB
 endif
 
+ifdef USDT
+	USE_USDT_PROBES=-D_USE_USDT_PROBES
+endif
+
 CC=$(COMPILER) -c -std=c++0x -D_XOPEN_SOURCE -DELPP_THREAD_SAFE \
-   $(USE_CANDIDATE_IO_LIB) $(USE_CANDIDATE_POLL_LIB) $(USE_CANDIDATE_FCTL_LIB)
+   $(USE_CANDIDATE_IO_LIB) $(USE_CANDIDATE_POLL_LIB) $(USE_CANDIDATE_FCTL_LIB) \
+   $(USE_USDT_PROBES)
 INCLUDE=-I.
 RESOLVE_DEP=$(COMPILER) -std=c++0x -MM $(INCLUDE)
 LINK=$(COMPILER) -rdynamic
@@ -0,0 +1,85 @@
+#include <map>
+#include <gtest/gtest.h>
+
+#include "core/client_registry.hpp"
+
+using namespace cerb;
+
+namespace {
+
+    std::map<std::string, ClientInfo> list_of(ClientRegistry const& r)
+    {
+        std::map<std::string, ClientInfo> m;
+        r.for_each([&](ClientInfo const& c) { m[c.addr] = c; });
+        return m;
+    }
+
+}
+
+TEST(ClientRegistry, AddUpdateRemove)
+{
+    ClientRegistry r;
+    msize_t a = r.add(nullptr, 10, "127.0.0.1:5000");
+    msize_t b = r.add(nullptr, 11, "127.0.0.1:5001");
+    r.update(b, [](ClientInfo& c) { c.commands = 7; c.qbuf = 64; });
+
+    auto m(list_of(r));
+    ASSERT_EQ(2, m.size());
+    ASSERT_EQ(10, m["127.0.0.1:5000"].fd);
+    ASSERT_EQ(0, m["127.0.0.1:5000"].commands);
+    ASSERT_EQ(7, m["127.0.0.1:5001"].commands);
+    ASSERT_EQ(64, m["127.0.0.1:5001"].qbuf);
+    ASSERT_NE(m["127.0.0.1:5000"].id, m["127.0.0.1:5001"].id);
+
+    r.remove(a);
+    m = list_of(r);
+    ASSERT_EQ(1, m.size());
+    ASSERT_EQ(11, m["127.0.0.1:5001"].fd);
+
+    /* the freed slot is reused by a client of a new id */
+    uint64_t old_id = m["127.0.0.1:5001"].id;
+    ASSERT_EQ(a, r.add(nullptr, 12, "127.0.0.1:5002"));
+    m = list_of(r);
+    ASSERT_EQ(2, m.size());
+    ASSERT_LT(old_id, m["127.0.0.1:5002"].id);
+}
+
+TEST(ClientRegistry, KillById)
+{
+    ClientRegistry r;
+    int x = 0;
+    int y = 0;
+    Client* cx = reinterpret_cast<Client*>(&x);
+    Client* cy = reinterpret_cast<Client*>(&y);
+    r.add(cx, 10, "127.0.0.1:5000");
+    msize_t sy = r.add(cy, 11, "127.0.0.1:5001");
+    auto m(list_of(r));
+    uint64_t id_y = m["127.0.0.1:5001"].id;
+
+    std::vector<Client*> killed;
+    r.take_kills([&](Client* c) { killed.push_back(c); });
+    ASSERT_TRUE(killed.empty());
+
+    ASSERT_FALSE(r.request_kill(id_y + 100));
+    ASSERT_TRUE(r.request_kill(id_y));
+    r.take_kills([&](Client* c) { killed.push_back(c); });
+    ASSERT_EQ(1, killed.size());
+    ASSERT_EQ(cy, killed[0]);
+
+    /* a client gone before the owner handles the request is not killed */
+    killed.clear();
+    ASSERT_TRUE(r.request_kill(id_y));
+    r.remove(sy);
+    r.add(cy, 11, "127.0.0.1:5001");
+    r.take_kills([&](Client* c) { killed.push_back(c); });
+    ASSERT_TRUE(killed.empty());
+}
+
+TEST(ClientRegistry, ManyChunks)
+{
+    ClientRegistry r;
+    for (int i = 0; i < 1000; ++i) {
+        r.add(nullptr, i, "127.0.0.1:" + std::to_string(i));
+    }
+    ASSERT_EQ(1000, list_of(r).size());
+}
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include "utils/histogram.hpp"
+
+TEST(Histogram, RecordIntoBuckets)
+{
+    util::Histogram h;
+    h.record(0);
+    h.record(100);
+    h.record(101);
+    h.record(3000);
+    h.record(100000000);
+
+    util::Histogram::Counts c;
+    h.add_to(c);
+    ASSERT_EQ(5, c.count());
+    ASSERT_EQ(100000000 + 3000 + 101 + 100, c.sum_us);
+    ASSERT_EQ(2, c.buckets[0]);
+    ASSERT_EQ(1, c.buckets[1]);
+    ASSERT_EQ(1, c.buckets[5]);
+    ASSERT_EQ(1, c.buckets[util::Histogram::BUCKETS - 1]);
+}
+
+TEST(Histogram, AddCounts)
+{
+    util::Histogram a;
+    util::Histogram b;
+    a.record(200);
+    b.record(200);
+    b.record(2000000);
+
+    util::Histogram::Counts c;
+    a.add_to(c);
+    b.add_to(c);
+    ASSERT_EQ(3, c.count());
+    ASSERT_EQ(2, c.buckets[1]);
+    ASSERT_EQ(1, c.buckets[13]);
+}
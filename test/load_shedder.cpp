@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include "core/load_shedder.hpp"
+#include "core/globals.hpp"
+
+using namespace cerb;
+
+namespace {
+
+    struct ShedConfig {
+        ShedConfig(int target_ms, int interval_ms, msize_t max_queue)
+        {
+            cerb_global::shed_target = std::chrono::milliseconds(target_ms);
+            cerb_global::shed_interval = std::chrono::milliseconds(interval_ms);
+            cerb_global::shed_max_queue = max_queue;
+        }
+
+        ~ShedConfig()
+        {
+            cerb_global::shed_target = Interval(0);
+            cerb_global::shed_interval = std::chrono::milliseconds(100);
+            cerb_global::shed_max_queue = 0;
+            cerb_global::shed_priority_commands.clear();
+            cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 0);
+        }
+    };
+
+    std::chrono::milliseconds ms(int n)
+    {
+        return std::chrono::milliseconds(n);
+    }
+
+}
+
+TEST(LoadShedder, DisabledByDefault)
+{
+    LoadShedder shedder;
+    Time now(Clock::now());
+    shedder.on_replied(ms(1000), now);
+    shedder.on_replied(ms(1000), now + ms(1000));
+    ASSERT_FALSE(shedder.overloaded());
+    ASSERT_TRUE(shedder.admit("GET"));
+}
+
+TEST(LoadShedder, OverloadedAfterInterval)
+{
+    ShedConfig conf(10, 100, 0);
+    cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 5);
+    cerb_global::shed_priority_commands.insert("GET");
+    int64_t shed = cerb_global::thread_stats.get(STAT_SHED_COMMANDS);
+
+    LoadShedder shedder;
+    Time now(Clock::now());
+    shedder.on_replied(ms(20), now);
+    shedder.on_replied(ms(20), now + ms(50));
+    ASSERT_FALSE(shedder.overloaded());
+    ASSERT_TRUE(shedder.admit("SET"));
+
+    shedder.on_replied(ms(20), now + ms(100));
+    ASSERT_TRUE(shedder.overloaded());
+    ASSERT_FALSE(shedder.admit("SET"));
+    ASSERT_TRUE(shedder.admit("GET"));
+    ASSERT_EQ(shed + 1, cerb_global::thread_stats.get(STAT_SHED_COMMANDS));
+
+    shedder.on_replied(ms(5), now + ms(120));
+    ASSERT_FALSE(shedder.overloaded());
+    ASSERT_TRUE(shedder.admit("SET"));
+
+    /* a reply within the target restarts the interval */
+    shedder.on_replied(ms(20), now + ms(130));
+    shedder.on_replied(ms(20), now + ms(200));
+    ASSERT_FALSE(shedder.overloaded());
+}
+
+TEST(LoadShedder, RecoverWhenQueueEmpty)
+{
+    ShedConfig conf(10, 100, 0);
+    cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 1);
+
+    LoadShedder shedder;
+    Time now(Clock::now());
+    shedder.on_replied(ms(20), now);
+    shedder.on_replied(ms(20), now + ms(100));
+    ASSERT_TRUE(shedder.overloaded());
+    ASSERT_FALSE(shedder.admit("SET"));
+
+    cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 0);
+    ASSERT_TRUE(shedder.admit("SET"));
+    ASSERT_FALSE(shedder.overloaded());
+}
+
+TEST(LoadShedder, MaxQueue)
+{
+    ShedConfig conf(0, 100, 3);
+    int64_t full = cerb_global::thread_stats.get(STAT_SHED_QUEUE_FULL);
+
+    LoadShedder shedder;
+    cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 2);
+    ASSERT_TRUE(shedder.admit("GET"));
+    cerb_global::thread_stats.set(STAT_QUEUED_COMMANDS, 3);
+    ASSERT_FALSE(shedder.admit("GET"));
+    ASSERT_EQ(full + 1, cerb_global::thread_stats.get(STAT_SHED_QUEUE_FULL));
+}
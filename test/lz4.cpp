@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "utils/lz4.hpp"
+
+static std::string round_trip(std::string const& s)
+{
+    std::string c(util::lz4_compress(s.data(), s.size()));
+    std::string d(s.size(), '\0');
+    EXPECT_TRUE(util::lz4_decompress(c.data(), c.size(), &d[0], d.size()));
+    return d;
+}
+
+TEST(LZ4, RoundTrip)
+{
+    ASSERT_EQ("", round_trip(""));
+    ASSERT_EQ("a", round_trip("a"));
+    ASSERT_EQ("hello, world", round_trip("hello, world"));
+    ASSERT_EQ("hello, world, hello, world", round_trip("hello, world, hello, world"));
+
+    std::string runs(100000, 'x');
+    ASSERT_EQ(runs, round_trip(runs));
+    ASSERT_GT(1000U, util::lz4_compress(runs.data(), runs.size()).size());
+
+    std::string text;
+    for (int i = 0; i < 5000; ++i) {
+        text += "{\"id\":" + std::to_string(i) + ",\"name\":\"user\",\"active\":true}";
+    }
+    ASSERT_EQ(text, round_trip(text));
+    ASSERT_GT(text.size() / 3, util::lz4_compress(text.data(), text.size()).size());
+
+    std::string noise;
+    unsigned seed = 1;
+    for (int i = 0; i < 70000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        noise += char(seed >> 16);
+    }
+    ASSERT_EQ(noise, round_trip(noise));
+}
+
+TEST(LZ4, ReferenceBlock)
+{
+    /* 24 bytes of "abc" as compressed by the reference library */
+    std::string block("\x3c" "abc" "\x03\x00" "\x50" "bcabc", 12);
+    char d[24];
+    ASSERT_TRUE(util::lz4_decompress(block.data(), block.size(), d, sizeof d));
+    ASSERT_EQ("abcabcabcabcabcabcabcabc", std::string(d, sizeof d));
+    ASSERT_EQ(block, util::lz4_compress(d, sizeof d));
+}
+
+TEST(LZ4, RejectCorrupted)
+{
+    std::string s;
+    for (int i = 0; i < 1000; ++i) {
+        s += "cerberus-" + std::to_string(i % 17);
+    }
+    std::string c(util::lz4_compress(s.data(), s.size()));
+    std::string d(s.size(), '\0');
+
+    ASSERT_FALSE(util::lz4_decompress(c.data(), c.size(), &d[0], d.size() - 1));
+    ASSERT_FALSE(util::lz4_decompress(c.data(), c.size() - 1, &d[0], d.size()));
+
+    std::string zero_offset("\x10" "a" "\x00\x00", 4);
+    ASSERT_FALSE(util::lz4_decompress(zero_offset.data(), zero_offset.size(), &d[0], 5));
+    std::string before_start("\x10" "a" "\x02\x00" "\x10" "b", 6);
+    ASSERT_FALSE(util::lz4_decompress(before_start.data(), before_start.size(), &d[0], 6));
+}
@@ -4,15 +4,12 @@
 using namespace cerb;
 
 Proxy::Proxy(int)
-    : _clients_count(0)
-    , _total_cmd_elapse(0)
-    , _total_remote_cost(0)
-    , _total_cmd(0)
-    , _last_cmd_elapse(0)
-    , _last_remote_cost(0)
-    , _slot_map_expired(false)
+    : _slot_map_expired(false)
+    , _waker(nullptr)
     , epfd(0)
     , acceptor(this, 0)
+    , slow_log(1)
+    , tracer(1)
 {}
 
 Proxy::~Proxy() {}
@@ -21,8 +18,12 @@ void Proxy::update_slot_map() {}
 void Proxy::new_client(int) {}
 void Proxy::pop_client(Client*) {}
 void Proxy::retry_move_ask_command_later(util::sref<DataCommand>) {}
+void Proxy::cancel_retry(util::sref<DataCommand>) {}
 void Proxy::stat_proccessed(Interval, Interval) {}
+void Proxy::incr_long_conn() {}
+void Proxy::decr_long_conn() {}
 void Proxy::inactivate_long_conn(cerb::Connection*) {}
+void Proxy::wakeup() {}
 
 void Proxy::poll_add_ro(Connection* conn)
 {
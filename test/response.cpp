@@ -5,6 +5,7 @@
 using cerb::Buffer;
 using cerb::Response;
 using cerb::split_server_response;
+using cerb::ReplyScanner;
 
 TEST(Response, String)
 {
@@ -48,3 +49,46 @@ TEST(Response, Array)
                   r[1]->get_buffer().to_string());
     }
 }
+
+/* feeds s in pieces of n bytes as the server buffer would hold them */
+static std::string scan_in_pieces(std::string const& s, std::string::size_type n)
+{
+    ReplyScanner scanner;
+    Buffer b;
+    std::string scanned;
+    for (std::string::size_type i = 0; i < s.size() && !scanner.finished(); i += n) {
+        Buffer piece(s.substr(i, n));
+        b.append_from(piece.begin(), piece.end());
+        std::string::size_type k = scanner.scan(b.begin(), b.end());
+        scanned += Buffer(b.begin(), b.begin() + k).to_string();
+        b.truncate_from_begin(b.begin() + k);
+    }
+    EXPECT_TRUE(scanner.finished());
+    return scanned;
+}
+
+TEST(Response, ScanReplyInPieces)
+{
+    std::string bulk("$26\r\nabcdefghijklmnopqrstuvwxyz\r\n");
+    std::string arr("*3\r\n"
+                        "$3\r\nabc\r\n"
+                        "*2\r\n" ":1\r\n" "$-1\r\n"
+                        "*0\r\n");
+    for (std::string::size_type n = 1; n <= 8; ++n) {
+        ASSERT_EQ(bulk, scan_in_pieces(bulk + "+OK\r\n", n));
+        ASSERT_EQ(arr, scan_in_pieces(arr + "$1\r\nx\r\n", n));
+    }
+
+    ReplyScanner scanner;
+    Buffer b("*2\r\n$5\r\nhel");
+    ASSERT_EQ(11, scanner.scan(b.begin(), b.end()));
+    ASSERT_FALSE(scanner.finished());
+    b = Buffer("lo\r\n-ERR x\r\n:0\r\n");
+    ASSERT_EQ(12, scanner.scan(b.begin(), b.end()));
+    ASSERT_TRUE(scanner.finished());
+
+    ReplyScanner partial_line;
+    b = Buffer("*10");
+    ASSERT_EQ(0, partial_line.scan(b.begin(), b.end()));
+    ASSERT_FALSE(partial_line.finished());
+}
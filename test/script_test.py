@@ -121,5 +121,230 @@ class ScriptTest(unittest.TestCase):
         r = self.t.eval('return KEYS[1]', '1', 'a')
         self.assertEqual('a', r)
 
+    def test_evalsha(self):
+        sha = self.t.script_load('return KEYS[1]')
+        for k in ['a', 'b', 'c', 'd']:
+            self.assertEqual(k, self.t.evalsha(sha, '1', k))
+        self.assertTrue(self.t.script_flush())
+        with self.assertRaises(redis.exceptions.NoScriptError):
+            self.t.evalsha(sha, '1', 'a')
+
+    def test_scan(self):
+        keys = {'scan:%d' % i for i in xrange(200)}
+        for k in keys:
+            self.assertTrue(self.t.set(k, k))
+        scanned = []
+        cursor, r = self.t.scan(0, match='scan:*', count=30)
+        scanned.extend(r)
+        while cursor != 0:
+            cursor, r = self.t.scan(cursor, match='scan:*', count=30)
+            scanned.extend(r)
+        self.assertEqual(keys, set(scanned))
+        self.assertEqual(len(keys), self.t.delete(*keys))
+
+    def test_scatter_commands(self):
+        keys = {'scatter:%d' % i for i in xrange(100)}
+        for k in keys:
+            self.assertTrue(self.t.set(k, k))
+        self.assertEqual(keys, set(self.t.keys('scatter:*')))
+        self.assertLessEqual(len(keys), self.t.dbsize())
+        self.assertIsNotNone(self.t.randomkey())
+        self.assertTrue(self.t.flushall())
+        self.assertEqual(0, self.t.dbsize())
+        self.assertEqual([], self.t.keys('*'))
+        self.assertIsNone(self.t.randomkey())
+
+    def test_transaction(self):
+        p = self.t.pipeline(transaction=True)
+        p.set('{tx}a', '1').incr('{tx}b').get('{tx}a')
+        self.assertEqual([True, 1, '1'], p.execute())
+        self.assertEqual('1', self.t.get('{tx}b'))
+
+        p = self.t.pipeline(transaction=True)
+        p.set('{tx}a', '2').set('{other}a', '2')
+        with self.assertRaises(redis.exceptions.ResponseError):
+            p.execute()
+        self.assertEqual('1', self.t.get('{tx}a'))
+        self.assertEqual(2, self.t.delete('{tx}a', '{tx}b'))
+
+    def test_set_operations(self):
+        self.assertEqual(4, self.t.sadd('seta', 'a', 'b', 'c', 'd'))
+        self.assertEqual(3, self.t.sadd('setb', 'c', 'd', 'e'))
+        self.assertEqual(2, self.t.sadd('setc', 'd', 'f'))
+        self.assertEqual({'d'}, self.t.sinter('seta', 'setb', 'setc'))
+        self.assertEqual({'a', 'b', 'c', 'd', 'e', 'f'},
+                         self.t.sunion('seta', 'setb', 'setc'))
+        self.assertEqual({'a', 'b'}, self.t.sdiff('seta', 'setb', 'setc'))
+        self.assertEqual(set(), self.t.sinter('seta', 'setnone'))
+
+        self.assertEqual(5, self.t.sunionstore('setd', 'seta', 'setb'))
+        self.assertEqual({'a', 'b', 'c', 'd', 'e'}, self.t.smembers('setd'))
+        self.assertEqual(2, self.t.sinterstore('setd', 'seta', 'setb'))
+        self.assertEqual({'c', 'd'}, self.t.smembers('setd'))
+        self.assertEqual(0, self.t.sdiffstore('setd', 'setc', 'setc'))
+        self.assertFalse(self.t.exists('setd'))
+        self.assertEqual(3, self.t.delete('seta', 'setb', 'setc'))
+
+    def test_sorted_set_store(self):
+        self.assertEqual(3, self.t.zadd('zseta', a=1, b=2, c=3))
+        self.assertEqual(3, self.t.zadd('zsetb', b=10, c=20, d=30))
+        self.assertEqual(4, self.t.zunionstore('zsetd', ['zseta', 'zsetb']))
+        self.assertEqual([('a', 1), ('b', 12), ('c', 23), ('d', 30)],
+                         self.t.zrange('zsetd', 0, -1, withscores=True))
+        self.assertEqual(2, self.t.zinterstore(
+            'zsetd', {'zseta': 2, 'zsetb': 1}, aggregate='MIN'))
+        self.assertEqual([('b', 4), ('c', 6)],
+                         self.t.zrange('zsetd', 0, -1, withscores=True))
+        self.assertEqual(0, self.t.zinterstore('zsetd', ['zseta', 'zsetnone']))
+        self.assertFalse(self.t.exists('zsetd'))
+        self.assertEqual(2, self.t.delete('zseta', 'zsetb'))
+
+        # operands larger than one page of the fetch
+        self.assertEqual(2500, self.t.zadd(
+            'zseta', **{'m%d' % i: i for i in range(2500)}))
+        self.assertEqual(2100, self.t.zadd(
+            'zsetb', **{'m%d' % i: 1 for i in range(1000, 3100)}))
+        self.assertEqual(3100, self.t.zunionstore('zsetd', ['zseta', 'zsetb']))
+        self.assertEqual(1500, self.t.zinterstore('zsetd', ['zseta', 'zsetb']))
+        self.assertEqual([('m2499', 2500)],
+                         self.t.zrange('zsetd', -1, -1, withscores=True))
+        self.assertEqual(3, self.t.delete('zseta', 'zsetb', 'zsetd'))
+
+    def test_rename(self):
+        self.assertEqual(2, self.t.sadd('renamesrc', 'a', 'b'))
+        self.assertTrue(self.t.pexpire('renamesrc', 100000))
+        self.assertTrue(self.t.rename('renamesrc', 'renamedst'))
+        self.assertFalse(self.t.exists('renamesrc'))
+        self.assertEqual({'a', 'b'}, self.t.smembers('renamedst'))
+        self.assertLess(0, self.t.pttl('renamedst'))
+
+        self.assertTrue(self.t.set('renameother', 'x'))
+        self.assertFalse(self.t.renamenx('renamedst', 'renameother'))
+        self.assertTrue(self.t.renamenx('renamedst', 'renamesrc'))
+        self.assertEqual({'a', 'b'}, self.t.smembers('renamesrc'))
+        with self.assertRaises(redis.exceptions.ResponseError):
+            self.t.rename('renamedst', 'renamesrc')
+        self.assertEqual(2, self.t.delete('renamesrc', 'renameother'))
+
+    def test_proxy_bulk(self):
+        conn = self.t.connection_pool.get_connection('PROXY')
+        try:
+            conn.send_command('PROXY', 'BULK')
+            self.assertEqual('OK', conn.read_response())
+            for i in xrange(1000):
+                conn.send_command('SET', 'bulk:%d' % i, i)
+            conn.send_command('SET', 'bulk:0')
+            conn.send_command('PROXY', 'BULK', 'END')
+            r = conn.read_response()
+            self.assertEqual(['ok', 1000, 'errors', 1], r[:4])
+            self.assertEqual(1, len(r[4]))
+        finally:
+            self.t.connection_pool.release(conn)
+        self.assertEqual('999', self.t.get('bulk:999'))
+        with self.assertRaises(redis.exceptions.ResponseError):
+            self.t.execute_command('PROXY', 'BULK', 'END')
+
+    def test_proxy_noreply(self):
+        t = redis.Redis(host='127.0.0.1', port=27182)
+        self.assertTrue(t.set('noreply:a', 'x'))
+        self.assertEqual('OK', t.execute_command('PROXY', 'NOREPLY', 'ON'))
+        self.assertTrue(t.set('noreply:a', '1'))
+        self.assertTrue(t.incrby('noreply:b', 2))
+        self.assertTrue(t.incrby('noreply:b', 3))
+        self.assertEqual('OK', t.execute_command('PROXY', 'NOREPLY', 'OFF'))
+        time.sleep(0.1)
+        self.assertEqual('1', t.get('noreply:a'))
+        self.assertEqual(6, t.incr('noreply:b'))
+        self.assertEqual(2, t.delete('noreply:a', 'noreply:b'))
+
+    def test_proxy_noreply_after_pending(self):
+        t = redis.Redis(host='127.0.0.1', port=27182)
+        t.rpush('noreply:l', 'a')
+        self.assertEqual('OK', t.execute_command('PROXY', 'NOREPLY', 'ON'))
+        pipe = t.pipeline(transaction=False)
+        pipe.delete('noreply:l')
+        pipe.rpush('noreply:l', 'b')
+        pipe.execute()
+        self.assertEqual('OK', t.execute_command('PROXY', 'NOREPLY', 'OFF'))
+        time.sleep(0.1)
+        self.assertEqual(['b'], t.lrange('noreply:l', 0, -1))
+        self.assertEqual(1, t.delete('noreply:l'))
+
+    def test_coalesce(self):
+        pipe = self.t.pipeline(transaction=False)
+        for i in xrange(100):
+            pipe.incrby('coalesce:a', 2)
+            pipe.hincrby('coalesce:h', 'f', 1)
+        pipe.decrby('coalesce:a', 10)
+        r = pipe.execute()
+        self.assertEqual(range(2, 202, 2), r[0:200:2])
+        self.assertEqual(range(1, 101), r[1:200:2])
+        self.assertEqual(190, r[200])
+        self.assertEqual('190', self.t.get('coalesce:a'))
+        self.assertEqual(2, self.t.delete('coalesce:a', 'coalesce:h'))
+
+    def test_compress(self):
+        value = 'the quick brown fox ' * 500
+        self.assertTrue(self.t.set('compress:a', value))
+        self.assertEqual(value, self.t.get('compress:a'))
+        self.assertGreater(len(value) / 10, self.t.strlen('compress:a'))
+
+        self.assertTrue(self.t.mset({'compress:b': value, 'plain': value,
+                                     'compress:c': 'short'}))
+        self.assertEqual([value, value, 'short', None], self.t.mget(
+            'compress:b', 'plain', 'compress:c', 'compress:none'))
+        self.assertEqual(len(value), self.t.strlen('plain'))
+        self.assertEqual(5, self.t.strlen('compress:c'))
+
+        self.assertTrue(self.t.hmset('compress:h', {'f': value, 'g': 'short'}))
+        self.assertEqual(value, self.t.hget('compress:h', 'f'))
+        self.assertEqual('short', self.t.hget('compress:h', 'g'))
+        self.assertEqual(4, self.t.delete(
+            'compress:a', 'compress:b', 'compress:c', 'compress:h'))
+
+    def test_large_reply(self):
+        value = ''.join(chr(ord('a') + i % 26) for i in xrange(1000000))
+        self.assertTrue(self.t.set('large', value))
+        self.assertEqual(value, self.t.get('large'))
+        self.assertEqual(20000, self.t.rpush('large-list', *[value[:50]] * 20000))
+        p = self.t.pipeline(transaction=False)
+        p.get('large').lrange('large-list', 0, -1).get('large')
+        self.assertEqual([value, [value[:50]] * 20000, value], p.execute())
+        self.assertEqual(2, self.t.delete('large', 'large-list'))
+
+    def test_large_request(self):
+        value = ''.join(chr(ord('a') + i % 26) for i in xrange(1000000))
+        p = self.t.pipeline(transaction=False)
+        p.set('large', value).strlen('large').get('large')
+        p.hset('large-hash', 'f', value).hget('large-hash', 'f')
+        self.assertEqual([True, len(value), value, 1, value], p.execute())
+        self.assertEqual(2, self.t.delete('large', 'large-hash'))
+
+    def test_fanout_limits(self):
+        keys = ['fanout-%d' % i for i in xrange(2000)]
+        self.assertTrue(self.t.mset({k: k[::-1] for k in keys}))
+        self.assertEqual([k[::-1] for k in keys], self.t.mget(*keys))
+        self.assertEqual(len(keys), self.t.delete(*keys))
+        self.assertEqual([None] * len(keys), self.t.mget(*keys))
+
+        with self.assertRaises(redis.exceptions.ResponseError):
+            self.t.mget(*['fanout-%d' % i for i in xrange(10001)])
+        self.assertEqual([None], self.t.mget('fanout-0'))
+
+    def test_fanout_window_keeps_pipeline_order(self):
+        keys = ['{fanout}%d' % i for i in xrange(100)]
+        self.assertTrue(self.t.mset({k: 'x' for k in keys}))
+        pipe = self.t.pipeline(transaction=False)
+        pipe.delete(*keys)
+        pipe.set(keys[-1], 'y')
+        self.assertEqual([len(keys), True], pipe.execute())
+        self.assertEqual('y', self.t.get(keys[-1]))
+
+        pipe = self.t.pipeline(transaction=False)
+        pipe.mset({k: 'z' for k in keys})
+        pipe.get(keys[-1])
+        self.assertEqual([True, 'z'], pipe.execute())
+        self.assertEqual(len(keys), self.t.delete(*keys))
+
 if __name__ == '__main__':
     main()
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "utils/seq_ring.hpp"
+
+static std::vector<int> all_of(util::SeqRing<int> const& r)
+{
+    std::vector<int> v;
+    r.for_each([&](int x) { v.push_back(x); return true; });
+    return v;
+}
+
+TEST(SeqRing, PushAndIterateNewestFirst)
+{
+    util::SeqRing<int> r(4);
+    ASSERT_EQ(4, r.capacity());
+    ASSERT_TRUE(all_of(r).empty());
+
+    r.push(1);
+    r.push(2);
+    ASSERT_EQ(std::vector<int>({2, 1}), all_of(r));
+    ASSERT_EQ(2, r.pushed());
+}
+
+TEST(SeqRing, OverwriteOldest)
+{
+    util::SeqRing<int> r(3);
+    for (int i = 0; i < 7; ++i) {
+        r.push(i);
+    }
+    ASSERT_EQ(std::vector<int>({6, 5, 4}), all_of(r));
+    ASSERT_EQ(7, r.pushed());
+}
+
+TEST(SeqRing, StopIteration)
+{
+    util::SeqRing<int> r(8);
+    for (int i = 0; i < 5; ++i) {
+        r.push(i);
+    }
+    std::vector<int> v;
+    r.for_each(
+        [&](int x)
+        {
+            if (x < 3) {
+                return false;
+            }
+            v.push_back(x);
+            return true;
+        });
+    ASSERT_EQ(std::vector<int>({4, 3}), v);
+}
@@ -415,3 +415,22 @@ TEST_F(SlotMapTest, NonsenseProof)
     ASSERT_TRUE(closed_servers().empty());
     ASSERT_TRUE(created_servers().empty());
 }
+
+TEST_F(SlotMapTest, NodeSlots)
+{
+    cerb::SlotMap slot_map;
+    ASSERT_TRUE(slot_map.node_slots().empty());
+
+    slot_map.replace_map(cerb::parse_slot_map(
+        "69853562969c74ff387f9e491d025b2a86ac478f 192.168.1.100:7002 master - 0 0 3 connected 8192-12287\n"
+        "2560c867f9ca2ef4cc872eb85ce985373ad9e815 192.168.1.101:7003 master - 0 0 2 connected 0-4095 12288-16383\n"
+        "933970b4fd2d1ad06166ab1d893e8cac7b129ebd 192.168.1.101:7001 master - 0 0 4 connected 4096-8191\n",
+        "127.0.0.1"), nullptr);
+    clear_all_servers();
+
+    std::vector<cerb::slot> slots(slot_map.node_slots());
+    ASSERT_EQ(3, slots.size());
+    ASSERT_EQ(0, slots[0]);
+    ASSERT_EQ(4096, slots[1]);
+    ASSERT_EQ(8192, slots[2]);
+}
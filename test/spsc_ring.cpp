@@ -0,0 +1,64 @@
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "utils/spsc_ring.hpp"
+
+TEST(SpscRing, PushPopInOrder)
+{
+    util::SpscRing<int> r(3);
+    int x;
+    ASSERT_FALSE(r.pop(x));
+
+    ASSERT_TRUE(r.push(1));
+    ASSERT_TRUE(r.push(2));
+    ASSERT_TRUE(r.push(3));
+    ASSERT_FALSE(r.push(4));
+
+    ASSERT_TRUE(r.pop(x));
+    ASSERT_EQ(1, x);
+    ASSERT_TRUE(r.push(5));
+    ASSERT_TRUE(r.pop(x));
+    ASSERT_EQ(2, x);
+    ASSERT_TRUE(r.pop(x));
+    ASSERT_EQ(3, x);
+    ASSERT_TRUE(r.pop(x));
+    ASSERT_EQ(5, x);
+    ASSERT_FALSE(r.pop(x));
+}
+
+TEST(SpscRing, ConcurrentProducerConsumer)
+{
+    util::SpscRing<int> r(16);
+    int const total = 100000;
+    int dropped = 0;
+    std::thread producer(
+        [&]()
+        {
+            for (int i = 0; i < total; ++i) {
+                if (!r.push(i)) {
+                    ++dropped;
+                }
+            }
+            while (!r.push(-1)) {
+                std::this_thread::yield();
+            }
+        });
+
+    int received = 0;
+    int last = -1;
+    while (true) {
+        int x;
+        if (!r.pop(x)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (x == -1) {
+            break;
+        }
+        ASSERT_LT(last, x);
+        last = x;
+        ++received;
+    }
+    producer.join();
+    ASSERT_EQ(total, received + dropped);
+}
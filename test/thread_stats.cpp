@@ -0,0 +1,57 @@
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "core/stats.hpp"
+
+using namespace cerb;
+
+TEST(ThreadStats, UpdateAndSnapshot)
+{
+    ThreadStats stats;
+    stats.add(STAT_CLIENTS, 3);
+    stats.add(STAT_CLIENTS, -1);
+    stats.set(STAT_ACCEPTING, 1);
+    stats.update(
+        [](ThreadStats::Writer& w)
+        {
+            w.add(STAT_COMPLETED_COMMANDS, 2);
+            w.set(STAT_LAST_CMD_ELAPSE_NS, 100);
+        });
+
+    StatsSnapshot s(stats.snapshot());
+    ASSERT_EQ(2, s[STAT_CLIENTS]);
+    ASSERT_EQ(1, s[STAT_ACCEPTING]);
+    ASSERT_EQ(2, s[STAT_COMPLETED_COMMANDS]);
+    ASSERT_EQ(100, s[STAT_LAST_CMD_ELAPSE_NS]);
+    ASSERT_EQ(0, s[STAT_BUFFER_ALLOCATED]);
+
+    StatsSnapshot total;
+    total += s;
+    total += s;
+    ASSERT_EQ(4, total[STAT_CLIENTS]);
+    ASSERT_EQ(4, total[STAT_COMPLETED_COMMANDS]);
+}
+
+TEST(ThreadStats, SnapshotConsistentWithConcurrentWriter)
+{
+    ThreadStats stats;
+    std::atomic_bool stop(false);
+    std::thread writer(
+        [&]()
+        {
+            while (!stop) {
+                stats.update(
+                    [](ThreadStats::Writer& w)
+                    {
+                        w.add(STAT_COMPLETED_COMMANDS, 1);
+                        w.add(STAT_CMD_ELAPSE_NS, 7);
+                    });
+            }
+        });
+    for (int i = 0; i < 10000; ++i) {
+        StatsSnapshot s(stats.snapshot());
+        ASSERT_EQ(s[STAT_COMPLETED_COMMANDS] * 7, s[STAT_CMD_ELAPSE_NS]);
+    }
+    stop = true;
+    writer.join();
+}
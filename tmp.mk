@@ -0,0 +1,3 @@
+backtracpp/sig-handler.o: backtracpp/sig-handler.cpp backtracpp/sig-handler.h \
+ backtracpp/trace.h backtracpp/demangle.h
+	g++ -c -std=c++14 -D_XOPEN_SOURCE -DELPP_THREAD_SAFE backtracpp/sig-handler.cpp -Wall -Wextra -Wold-style-cast -Werror -Wno-deprecated-declarations -Wno-range-loop-construct -Wno-redundant-move -Wno-pessimizing-move -include numeric -include vector -include map -include functional -include algorithm -include memory -O3 -DELPP_DISABLE_DEBUG_LOGS -DELPP_NO_DEFAULT_LOG_FILE -o backtracpp/sig-handler.o
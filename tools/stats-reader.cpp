@@ -0,0 +1,123 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "core/shm_stats_layout.h"
+
+/*
+ * Reads the stats file published by a proxy with `stats-shm' option set and
+ * prints it in the same "name:value,value,..." form as the INFO command.
+ *
+ *     cerberus-stats NAME_OR_PATH
+ */
+
+namespace {
+
+    struct Stats {
+        std::vector<std::string> names;
+        std::vector<int64_t> values;
+        int64_t update_time_ms;
+        int64_t publish_count;
+    };
+
+    bool read_consistent(cerb_shm_stats_header const* header, char const* base,
+                         Stats& stats)
+    {
+        int64_t const* values = reinterpret_cast<int64_t const*>(
+            base + header->values_offset);
+        uint64_t count = uint64_t(header->thread_count) * header->field_count;
+        for (int retry = 0; retry < 1000; ++retry) {
+            uint64_t seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+            if (seq % 2 == 1) {
+                ::usleep(100);
+                continue;
+            }
+            stats.values.resize(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                stats.values[i] = __atomic_load_n(&values[i], __ATOMIC_RELAXED);
+            }
+            stats.update_time_ms = __atomic_load_n(&header->update_time_ms, __ATOMIC_RELAXED);
+            stats.publish_count = __atomic_load_n(&header->publish_count, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (seq == __atomic_load_n(&header->seq, __ATOMIC_RELAXED)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2) {
+        std::cerr << "Usage:" << std::endl;
+        std::cerr << "    " << argv[0] << " NAME_OR_PATH" << std::endl;
+        std::cerr << "  where NAME_OR_PATH is the value of `stats-shm'"
+                     " in proxy configuration, or a path to the file" << std::endl;
+        return 1;
+    }
+    std::string path(argv[1]);
+    if (path.find('/') == std::string::npos) {
+        path = "/dev/shm/" + path;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "Fail to open " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == -1 || st.st_size < off_t(sizeof(cerb_shm_stats_header))) {
+        std::cerr << "Invalid stats file " << path << std::endl;
+        return 1;
+    }
+    void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "Fail to map " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    char const* base = static_cast<char const*>(p);
+    cerb_shm_stats_header const* header = static_cast<cerb_shm_stats_header const*>(p);
+    if (std::memcmp(header->magic, CERB_SHM_STATS_MAGIC, sizeof header->magic) != 0
+        || header->version != CERB_SHM_STATS_VERSION
+        || header->values_offset + uint64_t(header->thread_count) *
+               header->field_count * sizeof(int64_t) > uint64_t(st.st_size))
+    {
+        std::cerr << "Unsupported stats file " << path << std::endl;
+        return 1;
+    }
+
+    Stats stats;
+    if (!read_consistent(header, base, stats)) {
+        std::cerr << "Stats file keeps changing; publisher stuck?" << std::endl;
+        return 1;
+    }
+    std::cout << "version:" << std::string(header->proxy_version,
+                                           strnlen(header->proxy_version,
+                                                   sizeof header->proxy_version))
+              << std::endl;
+    std::cout << "pid:" << header->pid << std::endl;
+    std::cout << "alive:" << (::kill(header->pid, 0) == 0 ? 1 : 0) << std::endl;
+    std::cout << "update_time_ms:" << stats.update_time_ms << std::endl;
+    std::cout << "publish_count:" << stats.publish_count << std::endl;
+    std::cout << "threads:" << header->thread_count << std::endl;
+    for (uint32_t f = 0; f < header->field_count; ++f) {
+        char const* name = base + header->names_offset + f * CERB_SHM_STATS_NAME_LEN;
+        std::cout << std::string(name, strnlen(name, CERB_SHM_STATS_NAME_LEN)) << ":";
+        for (uint32_t t = 0; t < header->thread_count; ++t) {
+            if (t != 0) {
+                std::cout << ",";
+            }
+            std::cout << stats.values[t * header->field_count + f];
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef __CERBERUS_UTILITY_HISTOGRAM_HPP__
+#define __CERBERUS_UTILITY_HISTOGRAM_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+namespace util {
+
+    /*
+     * Latency histogram with fixed buckets in microseconds.
+     * Recorded by its owner thread only; other threads may read it at any time
+     * (relaxed loads, so a reading may lag behind by a few samples).
+     */
+    class Histogram {
+    public:
+        static int const BUCKETS = 15;
+
+        /* upper bound of bucket i; the last bucket is unbounded */
+        static uint64_t upper_bound_us(int i)
+        {
+            static uint64_t const bounds[BUCKETS - 1] = {
+                100, 250, 500,
+                1000, 2500, 5000,
+                10000, 25000, 50000,
+                100000, 250000, 500000,
+                1000000, 2500000,
+            };
+            return bounds[i];
+        }
+
+        struct Counts {
+            uint64_t buckets[BUCKETS];
+            uint64_t sum_us;
+
+            Counts()
+                : sum_us(0)
+            {
+                for (int i = 0; i < BUCKETS; ++i) {
+                    buckets[i] = 0;
+                }
+            }
+
+            uint64_t count() const
+            {
+                uint64_t n = 0;
+                for (int i = 0; i < BUCKETS; ++i) {
+                    n += buckets[i];
+                }
+                return n;
+            }
+        };
+    private:
+        std::atomic<uint64_t> _buckets[BUCKETS];
+        std::atomic<uint64_t> _sum_us;
+
+        static void _incr(std::atomic<uint64_t>& a, uint64_t n)
+        {
+            a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    public:
+        Histogram()
+            : _sum_us(0)
+        {
+            for (int i = 0; i < BUCKETS; ++i) {
+                _buckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        Histogram(Histogram const&) = delete;
+
+        void record(uint64_t us)
+        {
+            int i = 0;
+            while (i < BUCKETS - 1 && upper_bound_us(i) < us) {
+                ++i;
+            }
+            _incr(_buckets[i], 1);
+            _incr(_sum_us, us);
+        }
+
+        void add_to(Counts& c) const
+        {
+            for (int i = 0; i < BUCKETS; ++i) {
+                c.buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+            }
+            c.sum_us += _sum_us.load(std::memory_order_relaxed);
+        }
+    };
+
+}
+
+#endif /* __CERBERUS_UTILITY_HISTOGRAM_HPP__ */
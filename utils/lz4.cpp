@@ -0,0 +1,158 @@
+#include <cstring>
+#include <vector>
+
+#include "lz4.hpp"
+
+using cerb::byte;
+using cerb::msize_t;
+
+namespace {
+
+    int const HASH_LOG = 14;
+    msize_t const MIN_MATCH = 4;
+    /* the last 5 bytes are always literals */
+    msize_t const LAST_LITERALS = 5;
+    /* a match shall start at least 12 bytes before the end */
+    msize_t const MF_LIMIT = 12;
+    msize_t const MAX_OFFSET = 65535;
+
+    uint32_t read32(char const* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    uint32_t hash(uint32_t seq)
+    {
+        return (seq * 2654435761U) >> (32 - HASH_LOG);
+    }
+
+    void write_length(std::string& out, msize_t n)
+    {
+        for (; n >= 255; n -= 255) {
+            out += char(255);
+        }
+        out += char(n);
+    }
+
+    void write_sequence(std::string& out, char const* literals, msize_t literal_len,
+                        msize_t offset, msize_t match_len)
+    {
+        msize_t ml = match_len - MIN_MATCH;
+        out += char(((literal_len < 15 ? literal_len : 15) << 4) | (ml < 15 ? ml : 15));
+        if (literal_len >= 15) {
+            ::write_length(out, literal_len - 15);
+        }
+        out.append(literals, literal_len);
+        out += char(offset & 0xff);
+        out += char(offset >> 8);
+        if (ml >= 15) {
+            ::write_length(out, ml - 15);
+        }
+    }
+
+    void write_last_literals(std::string& out, char const* literals, msize_t literal_len)
+    {
+        out += char((literal_len < 15 ? literal_len : 15) << 4);
+        if (literal_len >= 15) {
+            ::write_length(out, literal_len - 15);
+        }
+        out.append(literals, literal_len);
+    }
+
+    bool read_length(char const* src, msize_t len, msize_t& i, msize_t& n)
+    {
+        byte b;
+        do {
+            if (i >= len) {
+                return false;
+            }
+            b = byte(src[i++]);
+            n += b;
+        } while (b == 255);
+        return true;
+    }
+
+}
+
+std::string util::lz4_compress(char const* src, msize_t len)
+{
+    std::string out;
+    out.reserve(len + len / 255 + 16);
+    msize_t anchor = 0;
+    if (len > MF_LIMIT) {
+        std::vector<uint32_t> table(1 << HASH_LOG, 0);
+        msize_t const match_start_limit = len - MF_LIMIT;
+        msize_t const match_end_limit = len - LAST_LITERALS;
+        msize_t i = 0;
+        while (i < match_start_limit) {
+            uint32_t seq = ::read32(src + i);
+            uint32_t& entry = table[::hash(seq)];
+            msize_t ref = entry;
+            entry = uint32_t(i);
+            if (ref >= i || i - ref > MAX_OFFSET || ::read32(src + ref) != seq) {
+                ++i;
+                continue;
+            }
+            msize_t end = i + MIN_MATCH;
+            for (msize_t r = ref + MIN_MATCH; end < match_end_limit && src[end] == src[r]; ++r) {
+                ++end;
+            }
+            for (; i > anchor && ref > 0 && src[i - 1] == src[ref - 1]; --ref) {
+                --i;
+            }
+            ::write_sequence(out, src + anchor, i - anchor, i - ref, end - i);
+            i = anchor = end;
+        }
+    }
+    ::write_last_literals(out, src + anchor, len - anchor);
+    return out;
+}
+
+bool util::lz4_decompress(char const* src, msize_t len, char* dst, msize_t dst_len)
+{
+    msize_t i = 0;
+    msize_t o = 0;
+    while (i < len) {
+        byte token = byte(src[i++]);
+        msize_t literal_len = token >> 4;
+        if (literal_len == 15 && !::read_length(src, len, i, literal_len)) {
+            return false;
+        }
+        if (literal_len > len - i || literal_len > dst_len - o) {
+            return false;
+        }
+        std::memcpy(dst + o, src + i, literal_len);
+        i += literal_len;
+        o += literal_len;
+        if (i == len) {
+            break;
+        }
+        if (len - i < 2) {
+            return false;
+        }
+        msize_t offset = byte(src[i]) | (msize_t(byte(src[i + 1])) << 8);
+        i += 2;
+        if (offset == 0 || offset > o) {
+            return false;
+        }
+        msize_t match_len = token & 15;
+        if (match_len == 15 && !::read_length(src, len, i, match_len)) {
+            return false;
+        }
+        match_len += MIN_MATCH;
+        if (match_len > dst_len - o) {
+            return false;
+        }
+        if (offset >= match_len) {
+            std::memcpy(dst + o, dst + o - offset, match_len);
+        } else {
+            for (msize_t k = 0; k < match_len; ++k) {
+                dst[o + k] = dst[o + k - offset];
+            }
+        }
+        o += match_len;
+    }
+    return o == dst_len;
+}
@@ -0,0 +1,21 @@
+#ifndef __CERBERUS_UTILITY_LZ4_HPP__
+#define __CERBERUS_UTILITY_LZ4_HPP__
+
+#include <string>
+
+#include "common.hpp"
+
+namespace util {
+
+    /*
+     * Raw blocks of the LZ4 block format, without frames or checksums,
+     * compressed greedily with a single hash table; they are decodable by
+     * LZ4_decompress_safe of the reference library and vice versa
+     */
+    std::string lz4_compress(char const* src, cerb::msize_t len);
+    /* returns false unless src decodes to exactly dst_len bytes */
+    bool lz4_decompress(char const* src, cerb::msize_t len, char* dst, cerb::msize_t dst_len);
+
+}
+
+#endif /* __CERBERUS_UTILITY_LZ4_HPP__ */
@@ -0,0 +1,93 @@
+#ifndef __CERBERUS_UTILITY_SEQUENCE_RING_HPP__
+#define __CERBERUS_UTILITY_SEQUENCE_RING_HPP__
+
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace util {
+
+    /*
+     * A fixed size ring written by one thread and read by any threads.
+     * Each slot is guarded by its own sequence number (odd while being written),
+     * so readers never block the writer; a slot overwritten during a read is skipped.
+     */
+    template <typename T>
+    class SeqRing {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "SeqRing element shall be trivially copyable");
+
+        struct Slot {
+            std::atomic<uint64_t> seq;
+            T value;
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        uint64_t const _capacity;
+        std::atomic<uint64_t> _head;
+    public:
+        explicit SeqRing(uint64_t capacity)
+            : _slots(new Slot[capacity == 0 ? 1 : capacity])
+            , _capacity(capacity == 0 ? 1 : capacity)
+            , _head(0)
+        {
+            for (uint64_t i = 0; i < _capacity; ++i) {
+                _slots[i].seq.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        SeqRing(SeqRing const&) = delete;
+
+        uint64_t capacity() const
+        {
+            return _capacity;
+        }
+
+        uint64_t pushed() const
+        {
+            return _head.load(std::memory_order_acquire);
+        }
+
+        /* writer thread only */
+        void push(T const& v)
+        {
+            uint64_t head = _head.load(std::memory_order_relaxed);
+            Slot& s = _slots[head % _capacity];
+            uint64_t seq = s.seq.load(std::memory_order_relaxed);
+            s.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&s.value, &v, sizeof(T));
+            s.seq.store(seq + 2, std::memory_order_release);
+            _head.store(head + 1, std::memory_order_release);
+        }
+
+        /* call f with each consistent element, newest first, until f returns false */
+        template <typename F>
+        void for_each(F f) const
+        {
+            uint64_t head = _head.load(std::memory_order_acquire);
+            uint64_t tail = head < _capacity ? 0 : head - _capacity;
+            for (uint64_t i = head; i > tail; --i) {
+                Slot const& s = _slots[(i - 1) % _capacity];
+                uint64_t seq = s.seq.load(std::memory_order_acquire);
+                if (seq % 2 == 1) {
+                    continue;
+                }
+                T copy;
+                std::memcpy(&copy, &s.value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq != s.seq.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                if (!f(copy)) {
+                    return;
+                }
+            }
+        }
+    };
+
+}
+
+#endif /* __CERBERUS_UTILITY_SEQUENCE_RING_HPP__ */
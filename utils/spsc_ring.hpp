@@ -0,0 +1,71 @@
+#ifndef __CERBERUS_UTILITY_SPSC_RING_HPP__
+#define __CERBERUS_UTILITY_SPSC_RING_HPP__
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace util {
+
+    /*
+     * A bounded ring of one producer thread and one consumer thread.
+     * Pushing to a full ring fails instead of waiting, so a slow consumer
+     * loses elements but never slows the producer down.
+     */
+    template <typename T>
+    class SpscRing {
+        /* one cache line for each index so producer and consumer do not share */
+        struct Index {
+            std::atomic<uint64_t> value;
+            char padding[64 - sizeof(std::atomic<uint64_t>)];
+
+            Index()
+                : value(0)
+            {}
+        };
+
+        std::unique_ptr<T[]> _elements;
+        uint64_t const _capacity;
+        Index _head;
+        Index _tail;
+    public:
+        explicit SpscRing(uint64_t capacity)
+            : _elements(new T[capacity == 0 ? 1 : capacity])
+            , _capacity(capacity == 0 ? 1 : capacity)
+        {}
+
+        SpscRing(SpscRing const&) = delete;
+
+        uint64_t capacity() const
+        {
+            return _capacity;
+        }
+
+        /* producer thread only; returns false if the ring is full */
+        bool push(T const& v)
+        {
+            uint64_t head = _head.value.load(std::memory_order_relaxed);
+            if (head - _tail.value.load(std::memory_order_acquire) == _capacity) {
+                return false;
+            }
+            _elements[head % _capacity] = v;
+            _head.value.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* consumer thread only; returns false if the ring is empty */
+        bool pop(T& v)
+        {
+            uint64_t tail = _tail.value.load(std::memory_order_relaxed);
+            if (tail == _head.value.load(std::memory_order_acquire)) {
+                return false;
+            }
+            v = _elements[tail % _capacity];
+            _tail.value.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+}
+
+#endif /* __CERBERUS_UTILITY_SPSC_RING_HPP__ */